@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef CSLPQ_BENCHMARK_TBB
+#include <tbb/concurrent_priority_queue.h>
+#endif
+
+#include "CSLPQ/Elimination.hpp"
+#include "CSLPQ/Queue.hpp"
+
+// Throughput and per operation latency of the queues and two baselines, for every combination of workload, key
+// distribution and thread count. Usage:
+//     Benchmark [max_threads] [ops_per_thread] [filter]
+// Thread counts double from 1 up to max_threads (default: the hardware threads) and end on it, every thread runs
+// ops_per_thread operations (default 100000), and only queues whose name contains filter run. Latencies are of single
+// operations including the clock reads around them, throughput is over the wall time of the whole run.
+
+struct FastTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+    typedef CSLPQ::PoolAllocator<uint64_t> Allocator;
+};
+
+struct LazyTraits : FastTraits
+{
+    typedef CSLPQ::LazyDeletion<> Deletion;
+};
+
+// Every queue is driven through Push and TryPop on uint64_t keys, key value queues carry the key as the value too
+template <typename Q>
+class KeyAdapter
+{
+    private:
+        Q queue;
+
+    public:
+        void Push(uint64_t key)
+        {
+            this->queue.Push(key);
+        }
+
+        bool TryPop(uint64_t& key)
+        {
+            return this->queue.TryPopStrong(key);
+        }
+};
+
+template <typename Q>
+class KVAdapter
+{
+    private:
+        Q queue;
+
+    public:
+        void Push(uint64_t key)
+        {
+            this->queue.Push(key, key);
+        }
+
+        bool TryPop(uint64_t& key)
+        {
+            uint64_t value = 0;
+            return this->queue.TryPopStrong(key, value);
+        }
+};
+
+class MutexHeap
+{
+    private:
+        std::mutex mutex;
+        std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> heap;
+
+    public:
+        void Push(uint64_t key)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->heap.push(key);
+        }
+
+        bool TryPop(uint64_t& key)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->heap.empty())
+            {
+                return false;
+            }
+            key = this->heap.top();
+            this->heap.pop();
+            return true;
+        }
+};
+
+#ifdef CSLPQ_BENCHMARK_TBB
+class TBBQueue
+{
+    private:
+        tbb::concurrent_priority_queue<uint64_t, std::greater<uint64_t>> queue;
+
+    public:
+        void Push(uint64_t key)
+        {
+            this->queue.push(key);
+        }
+
+        bool TryPop(uint64_t& key)
+        {
+            return this->queue.try_pop(key);
+        }
+};
+#endif
+
+enum Workload
+{
+    PushOnly,
+    PopOnly,
+    Mixed
+};
+
+enum Distribution
+{
+    Uniform,
+    Monotone,
+    Hold
+};
+
+const char* workload_names[] = {"push", "pop", "mixed"};
+const char* distribution_names[] = {"uniform", "monotone", "hold"};
+
+// Keys of one thread. Uniform keys are random, monotone keys increase across all threads, and hold keys are the last
+// key this thread popped plus a small random increment, like events scheduled shortly after the one being handled.
+class Keys
+{
+    private:
+        Distribution distribution;
+        uint64_t thread;
+        uint64_t threads;
+        uint64_t count;
+        uint64_t now;
+
+    public:
+        Keys(Distribution distribution, uint64_t thread, uint64_t threads) : distribution(distribution),
+                thread(thread), threads(threads), count(0), now(0)
+        {
+        }
+
+        uint64_t Next()
+        {
+            switch (this->distribution)
+            {
+                case Uniform:
+                    return CSLPQ::ThreadRandom::Get().Next() >> 16;
+                case Monotone:
+                    return (this->count++) * this->threads + this->thread;
+                default:
+                    return this->now + 1 + CSLPQ::ThreadRandom::Get().Next(1024);
+            }
+        }
+
+        void Popped(uint64_t key)
+        {
+            this->now = std::max(this->now, key);
+        }
+};
+
+struct Result
+{
+    double ops_per_second;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+};
+
+template <typename Q>
+Result Run(Workload workload, Distribution distribution, uint64_t threads, uint64_t ops)
+{
+    Q queue;
+    // Pops need something to pop, mixed runs keep about this many elements around
+    uint64_t prefill = workload == PopOnly ? threads * ops : (workload == Mixed ? 1 << 16 : 0);
+    {
+        Keys keys(distribution, 0, 1);
+        for (uint64_t i = 0; i < prefill; ++i)
+        {
+            uint64_t key = keys.Next();
+            queue.Push(key);
+            // Hold keys of the prefill spread forward as if each had been pushed while handling the one before
+            keys.Popped(key);
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> latencies(threads);
+    std::atomic<uint64_t> ready(0);
+    std::atomic<bool> start(false);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < threads; ++t)
+    {
+        ts.emplace_back([&, t]()
+        {
+            std::vector<uint32_t>& latency = latencies[t];
+            latency.reserve(ops);
+            Keys keys(distribution, t, threads);
+            uint64_t key = 0;
+            ready++;
+            while (!start.load())
+            {
+            }
+            for (uint64_t i = 0; i < ops; ++i)
+            {
+                bool push = workload == PushOnly || (workload == Mixed && (CSLPQ::ThreadRandom::Get().Next() & 1));
+                uint64_t next = push ? keys.Next() : 0;
+                auto before = std::chrono::steady_clock::now();
+                if (push)
+                {
+                    queue.Push(next);
+                }
+                else if (queue.TryPop(key))
+                {
+                    keys.Popped(key);
+                }
+                auto after = std::chrono::steady_clock::now();
+                latency.push_back(static_cast<uint32_t>(
+                        std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count(),
+                                          UINT32_MAX)));
+            }
+        });
+    }
+    while (ready.load() < threads)
+    {
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (uint64_t t = 0; t < threads; ++t)
+    {
+        ts[t].join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> all;
+    all.reserve(threads * ops);
+    for (uint64_t t = 0; t < threads; ++t)
+    {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    Result result;
+    result.ops_per_second = all.size() / std::chrono::duration<double>(end - begin).count();
+    result.p50 = all[all.size() / 2];
+    result.p99 = all[all.size() * 99 / 100];
+    result.p999 = all[all.size() * 999 / 1000];
+    return result;
+}
+
+struct Candidate
+{
+    const char* name;
+    Result (*run)(Workload, Distribution, uint64_t, uint64_t);
+};
+
+int main(int argc, char** argv)
+{
+    uint64_t max_threads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+    uint64_t ops = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+    std::string filter = argc > 3 ? argv[3] : "";
+    std::vector<uint64_t> thread_counts;
+    for (uint64_t threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(std::max<uint64_t>(max_threads, 1));
+
+    std::vector<Candidate> candidates = {
+        {"Queue", &Run<KeyAdapter<CSLPQ::Queue<uint64_t>>>},
+        {"Queue/Epoch+Pool", &Run<KeyAdapter<CSLPQ::Queue<uint64_t, 31, FastTraits>>>},
+        {"Queue/Epoch+Pool+Lazy", &Run<KeyAdapter<CSLPQ::Queue<uint64_t, 31, LazyTraits>>>},
+        {"EliminationQueue/Epoch+Pool",
+         &Run<CSLPQ::EliminationQueue<uint64_t, 8, CSLPQ::Queue<uint64_t, 31, FastTraits>>>},
+        {"KVQueue", &Run<KVAdapter<CSLPQ::KVQueue<uint64_t, uint64_t>>>},
+        {"KVQueue/Epoch+Pool", &Run<KVAdapter<CSLPQ::KVQueue<uint64_t, uint64_t, 31, FastTraits>>>},
+        {"std::priority_queue+mutex", &Run<MutexHeap>},
+#ifdef CSLPQ_BENCHMARK_TBB
+        {"tbb::concurrent_priority_queue", &Run<TBBQueue>},
+#endif
+    };
+
+    std::cout << std::left << std::setw(32) << "queue" << std::setw(8) << "work" << std::setw(10) << "keys"
+              << std::right << std::setw(8) << "threads" << std::setw(14) << "ops/s" << std::setw(10) << "p50 ns"
+              << std::setw(10) << "p99 ns" << std::setw(10) << "p999 ns" << std::endl;
+    for (size_t c = 0; c < candidates.size(); ++c)
+    {
+        if (std::string(candidates[c].name).find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        for (int w = PushOnly; w <= Mixed; ++w)
+        {
+            for (int d = Uniform; d <= Hold; ++d)
+            {
+                for (size_t i = 0; i < thread_counts.size(); ++i)
+                {
+                    uint64_t threads = thread_counts[i];
+                    Result result = candidates[c].run(static_cast<Workload>(w), static_cast<Distribution>(d), threads,
+                                                      ops);
+                    std::cout << std::left << std::setw(32) << candidates[c].name << std::setw(8) << workload_names[w]
+                              << std::setw(10) << distribution_names[d] << std::right << std::setw(8) << threads
+                              << std::setw(14) << std::fixed << std::setprecision(0) << result.ops_per_second
+                              << std::setw(10) << result.p50 << std::setw(10) << result.p99 << std::setw(10)
+                              << result.p999 << std::endl;
+                }
+            }
+        }
+    }
+    return 0;
+}
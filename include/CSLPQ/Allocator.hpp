@@ -0,0 +1,292 @@
+#ifndef __CSLPQ_ALLOCATOR_HPP__
+#define __CSLPQ_ALLOCATOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include "Numa.hpp"
+
+namespace CSLPQ
+{
+    // Fixed size, cache line aligned blocks carved from slabs that are never returned to the system. Each thread
+    // allocates from and frees to its own free list, batches of blocks move through a shared depot when a thread
+    // frees more than it allocates (consumers) or allocates more than it frees (producers). Slabs are bound to the
+    // NUMA node of the thread carving them and there is a depot per node, so blocks stay on the node they were
+    // carved on unless a thread frees a block of another node.
+    template <size_t S>
+    class BlockPool
+    {
+        public:
+            static const size_t cache_line = 64;
+            static const size_t block_size = (S + cache_line - 1) / cache_line * cache_line;
+
+        private:
+            static const size_t batch_size = 64;
+            static const size_t slab_size = 64 * 1024;
+            static const size_t page_size = 4096;
+            static const size_t slab_blocks = slab_size / block_size ? slab_size / block_size : 1;
+
+            struct Block
+            {
+                Block* next;
+            };
+
+            struct Depot
+            {
+                std::mutex mutex;
+                Block* head;
+                size_t count;
+
+                Depot() : head(nullptr), count(0)
+                {
+                }
+            };
+
+            // Trivially destructible so it stays usable while other thread locals are destroyed at thread exit
+            struct Cache
+            {
+                Block* head;
+                size_t count;
+                bool exited;
+            };
+
+            class Flusher
+            {
+                public:
+                    ~Flusher()
+                    {
+                        Cache& cache = LocalCache();
+                        ReturnToDepot(cache.head, cache.count);
+                        cache.head = nullptr;
+                        cache.count = 0;
+                        cache.exited = true;
+                    }
+            };
+
+            static Depot& GetDepot()
+            {
+                static Depot* depots = new Depot[NumaTopology::Nodes()];
+                return depots[NumaTopology::CurrentNode()];
+            }
+
+            static Cache& LocalCache()
+            {
+                static thread_local Cache cache = {nullptr, 0, false};
+                return cache;
+            }
+
+            static Cache& Local()
+            {
+                static thread_local Flusher flusher;
+                (void)flusher;
+                return LocalCache();
+            }
+
+            static void ReturnToDepot(Block* head, size_t count)
+            {
+                if (!head)
+                {
+                    return;
+                }
+                Block* tail = head;
+                while (tail->next)
+                {
+                    tail = tail->next;
+                }
+                Depot& depot = GetDepot();
+                std::lock_guard<std::mutex> lock(depot.mutex);
+                tail->next = depot.head;
+                depot.head = head;
+                depot.count += count;
+            }
+
+            static void Refill(Cache& cache)
+            {
+                Depot& depot = GetDepot();
+                {
+                    std::lock_guard<std::mutex> lock(depot.mutex);
+                    while (depot.head && cache.count < batch_size)
+                    {
+                        Block* block = depot.head;
+                        depot.head = block->next;
+                        --depot.count;
+                        block->next = cache.head;
+                        cache.head = block;
+                        ++cache.count;
+                    }
+                }
+                if (cache.head)
+                {
+                    return;
+                }
+
+                // Page aligned, the blocks are not touched before the slab is bound
+                void* memory = std::malloc(slab_blocks * block_size + page_size);
+                if (!memory)
+                {
+                    throw std::bad_alloc();
+                }
+                uintptr_t start = (reinterpret_cast<uintptr_t>(memory) + page_size - 1) & ~(uintptr_t)(page_size - 1);
+                NumaTopology::BindLocal(reinterpret_cast<void*>(start), slab_blocks * block_size);
+                for (size_t i = slab_blocks; i > 0; --i)
+                {
+                    Block* block = reinterpret_cast<Block*>(start + (i - 1) * block_size);
+                    block->next = cache.head;
+                    cache.head = block;
+                }
+                cache.count += slab_blocks;
+            }
+
+            static void Spill(Cache& cache)
+            {
+                Block* head = cache.head;
+                Block* tail = head;
+                for (size_t i = 1; i < batch_size; ++i)
+                {
+                    tail = tail->next;
+                }
+                cache.head = tail->next;
+                cache.count -= batch_size;
+                tail->next = nullptr;
+                ReturnToDepot(head, batch_size);
+            }
+
+        public:
+            static void* Allocate()
+            {
+                Cache& cache = Local();
+                if (!cache.head)
+                {
+                    Refill(cache);
+                }
+                Block* block = cache.head;
+                cache.head = block->next;
+                --cache.count;
+                return block;
+            }
+
+            static void Deallocate(void* pointer)
+            {
+                Block* block = static_cast<Block*>(pointer);
+                // Registers the flusher too, a thread that only frees must return its cache on exit as well
+                Cache& cache = Local();
+                if (cache.exited)
+                {
+                    block->next = nullptr;
+                    ReturnToDepot(block, 1);
+                    return;
+                }
+                block->next = cache.head;
+                cache.head = block;
+                if (++cache.count >= 2 * batch_size)
+                {
+                    Spill(cache);
+                }
+            }
+    };
+
+    // Dispatches a request of lines cache lines to the BlockPool of that size, one size class per line count from
+    // Lines up to Max. Small requests are the common ones, so they are tried first.
+    template <size_t Lines, size_t Max>
+    struct PoolClasses
+    {
+        static void* Allocate(size_t lines)
+        {
+            return lines == Lines ? BlockPool<Lines * 64>::Allocate() : PoolClasses<Lines + 1, Max>::Allocate(lines);
+        }
+
+        static void Deallocate(void* pointer, size_t lines)
+        {
+            if (lines == Lines)
+            {
+                BlockPool<Lines * 64>::Deallocate(pointer);
+            }
+            else
+            {
+                PoolClasses<Lines + 1, Max>::Deallocate(pointer, lines);
+            }
+        }
+    };
+
+    template <size_t Max>
+    struct PoolClasses<Max, Max>
+    {
+        static void* Allocate(size_t)
+        {
+            return BlockPool<Max * 64>::Allocate();
+        }
+
+        static void Deallocate(void* pointer, size_t)
+        {
+            BlockPool<Max * 64>::Deallocate(pointer);
+        }
+    };
+
+    // A stateless allocator serving requests of up to max_lines cache lines from the BlockPool of their size rounded
+    // up to whole lines, larger requests go to the global heap. Meant for the Allocator member of the queue traits,
+    // where it serves variable height nodes and their shared_ptr headers.
+    template <typename T>
+    class PoolAllocator
+    {
+        static_assert(alignof(T) <= 64, "Pooled types must not need more than cache line alignment");
+        public:
+            static const size_t max_lines = 8;
+
+            typedef T value_type;
+
+            template <typename U>
+            struct rebind
+            {
+                typedef PoolAllocator<U> other;
+            };
+
+            PoolAllocator() noexcept
+            {
+            }
+
+            template <typename U>
+            PoolAllocator(const PoolAllocator<U>&) noexcept
+            {
+            }
+
+            T* allocate(size_t n)
+            {
+                size_t lines = (n * sizeof(T) + 63) / 64;
+                if (lines <= max_lines)
+                {
+                    return static_cast<T*>(PoolClasses<1, max_lines>::Allocate(lines));
+                }
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            }
+
+            void deallocate(T* pointer, size_t n) noexcept
+            {
+                size_t lines = (n * sizeof(T) + 63) / 64;
+                if (lines <= max_lines)
+                {
+                    PoolClasses<1, max_lines>::Deallocate(pointer, lines);
+                }
+                else
+                {
+                    ::operator delete(pointer);
+                }
+            }
+    };
+
+    template <typename T, typename U>
+    bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept
+    {
+        return true;
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept
+    {
+        return false;
+    }
+}
+
+#endif // __CSLPQ_ALLOCATOR_HPP__
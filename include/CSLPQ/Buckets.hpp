@@ -0,0 +1,274 @@
+#ifndef __CSLPQ_BUCKETS_HPP__
+#define __CSLPQ_BUCKETS_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace CSLPQ
+{
+    // Every element gets a node of its own, equal keys are separate towers. This is the default.
+    struct NoBuckets
+    {
+        template <typename Item, typename A>
+        class Bucket
+        {
+            public:
+                static const bool enabled = false;
+
+                template <typename... Args>
+                bool TryPush(Args&&...)
+                {
+                    return false;
+                }
+
+                int TryPop()
+                {
+                    return -1;
+                }
+
+                bool Close()
+                {
+                    return true;
+                }
+
+                int Next(uint32_t) const
+                {
+                    return -1;
+                }
+
+                Item* Get(int) const
+                {
+                    return nullptr;
+                }
+        };
+    };
+
+    // Elements whose key equals the key of a node already in the queue go into a bucket of up to C elements hanging
+    // off that node, so a tie costs a search and a CAS instead of linking a tower. The slots are allocated by the
+    // first tie and filled and drained once, in order. A node leaves the queue only after its bucket was closed and
+    // drained, so its own element is popped last.
+    //
+    // The first I slots live in the bucket itself and the segment only holds the rest, so a bucket that never gets
+    // more than I elements allocates nothing. Node buckets keep none, the node holds the first element already.
+    template <uint32_t C = 64>
+    struct TieBuckets
+    {
+        static_assert(C > 0, "Buckets must hold at least one element");
+
+        template <typename Item, typename A, uint32_t I = 0>
+        class Bucket
+        {
+            static_assert(I <= C, "A bucket can't keep more slots inline than it holds");
+            private:
+                static const uint64_t closed_bit = 1;
+                static const uint32_t pending = 0;
+                static const uint32_t full = 1;
+                static const uint32_t empty = 2;
+
+                struct Slot
+                {
+                    typename std::aligned_storage<sizeof(Item), alignof(Item)>::type storage;
+                    std::atomic<uint32_t> state;
+                };
+
+                struct Segment
+                {
+                    Slot slots[C > I ? C - I : 1];
+
+                    Segment()
+                    {
+                        for (uint32_t i = 0; i < C - I; ++i)
+                        {
+                            this->slots[i].state.store(pending, std::memory_order_relaxed);
+                        }
+                    }
+                };
+
+                // The inline slots, an empty member when there are none
+                template <uint32_t N, bool = (N > 0)>
+                struct Local
+                {
+                    Slot slots[N];
+
+                    Local()
+                    {
+                        for (uint32_t i = 0; i < N; ++i)
+                        {
+                            this->slots[i].state.store(pending, std::memory_order_relaxed);
+                        }
+                    }
+
+                    Slot* Get(uint32_t index)
+                    {
+                        return &this->slots[index];
+                    }
+                };
+
+                template <uint32_t N>
+                struct Local<N, false>
+                {
+                    Slot* Get(uint32_t)
+                    {
+                        return nullptr;
+                    }
+                };
+
+                typedef typename std::allocator_traits<A>::template rebind_alloc<Segment> SegmentAllocator;
+
+                // Reserved slots shifted left by one, and the closed bit
+                std::atomic<uint64_t> state;
+                std::atomic<uint32_t> popped;
+                // Fits in the padding before segment when empty
+                mutable Local<I> local;
+                std::atomic<Segment*> segment;
+
+                // Segment must be loaded after the slot at index was reserved, unless index is inline
+                Slot& At(uint32_t index, Segment* slots) const
+                {
+                    return index < I ? *this->local.Get(index) : slots->slots[index - I];
+                }
+
+                Segment* GetSegment()
+                {
+                    Segment* current = this->segment.load();
+                    if (current)
+                    {
+                        return current;
+                    }
+                    SegmentAllocator allocator;
+                    Segment* created = new (allocator.allocate(1)) Segment();
+                    if (!this->segment.compare_exchange_strong(current, created))
+                    {
+                        created->~Segment();
+                        allocator.deallocate(created, 1);
+                        return current;
+                    }
+                    return created;
+                }
+
+            public:
+                static const bool enabled = true;
+
+                Bucket() : state(0), popped(0), segment(nullptr)
+                {
+                }
+
+                Bucket(const Bucket&) = delete;
+                Bucket& operator=(const Bucket&) = delete;
+
+                ~Bucket()
+                {
+                    Segment* current = this->segment.load();
+                    uint32_t reserved = std::min(static_cast<uint32_t>(this->state.load() >> 1), C);
+                    for (uint32_t i = 0; i < reserved; ++i)
+                    {
+                        Slot& slot = this->At(i, current);
+                        if (slot.state.load() == full)
+                        {
+                            reinterpret_cast<Item*>(&slot.storage)->~Item();
+                        }
+                    }
+                    if (!current)
+                    {
+                        return;
+                    }
+                    current->~Segment();
+                    SegmentAllocator allocator;
+                    allocator.deallocate(current, 1);
+                }
+
+                // Fails if the bucket is full or closed, args are only used on success
+                template <typename... Args>
+                bool TryPush(Args&&... args)
+                {
+                    uint64_t current = this->state.load();
+                    Segment* slots = nullptr;
+                    do
+                    {
+                        if ((current & closed_bit) || (current >> 1) >= C)
+                        {
+                            return false;
+                        }
+                        // Allocated before reserving a slot in it, so a failed allocation leaves no reserved slot behind
+                        if ((current >> 1) >= I && !slots)
+                        {
+                            slots = this->GetSegment();
+                        }
+                    }
+                    while (!this->state.compare_exchange_weak(current, current + 2));
+                    Slot& slot = this->At(static_cast<uint32_t>(current >> 1), slots);
+                    try
+                    {
+                        new (&slot.storage) Item(std::forward<Args>(args)...);
+                    }
+                    catch (...)
+                    {
+                        // Pops skip the slot, the element simply was not pushed
+                        slot.state.store(empty);
+                        throw;
+                    }
+                    slot.state.store(full);
+                    return true;
+                }
+
+                // The slot of a popped element, -1 if none finished its push. The element stays in its slot until the
+                // bucket is destroyed.
+                int TryPop()
+                {
+                    uint32_t index = this->popped.load();
+                    while (index < (this->state.load() >> 1))
+                    {
+                        uint32_t slot_state = this->At(index, this->segment.load()).state.load();
+                        if (slot_state == pending)
+                        {
+                            return -1;
+                        }
+                        if (this->popped.compare_exchange_weak(index, index + 1))
+                        {
+                            if (slot_state == full)
+                            {
+                                return index;
+                            }
+                            ++index;
+                        }
+                    }
+                    return -1;
+                }
+
+                // Stops further pushes, true once every element pushed before is popped
+                bool Close()
+                {
+                    uint64_t current = this->state.fetch_or(closed_bit);
+                    return this->popped.load() >= (current >> 1);
+                }
+
+                // The first slot from index on holding an element not popped yet, -1 if there is none. Only a look, the
+                // element may be popped right after.
+                int Next(uint32_t index) const
+                {
+                    uint32_t reserved = static_cast<uint32_t>(this->state.load() >> 1);
+                    Segment* slots = this->segment.load();
+                    for (index = std::max(index, this->popped.load()); index < reserved && index < C; ++index)
+                    {
+                        if (this->At(index, slots).state.load() == full)
+                        {
+                            return index;
+                        }
+                    }
+                    return -1;
+                }
+
+                Item* Get(int slot) const
+                {
+                    return reinterpret_cast<Item*>(&this->At(slot, this->segment.load()).storage);
+                }
+        };
+    };
+}
+
+#endif // __CSLPQ_BUCKETS_HPP__
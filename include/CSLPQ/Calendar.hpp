@@ -0,0 +1,457 @@
+#ifndef __CSLPQ_CALENDAR_HPP__
+#define __CSLPQ_CALENDAR_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Buckets.hpp"
+#include "Queue.hpp"
+#include "Reclamation.hpp"
+
+namespace CSLPQ
+{
+    // For unsigned integer keys moving forward in a narrow window, like timestamps. Keys less than W past the cursor,
+    // the start of the window, go into a ring of W buckets indexed by key modulo W. A bucket holds elements of exactly
+    // one key in TieBuckets slots, so pushing near the front is a CAS and popping reads the bucket under the cursor.
+    // The first element of a bucket sits in the bucket itself, slots for more are allocated by the second one, so
+    // sparse keys cost a small bucket each.
+    // Keys behind the cursor, W or more past it, or finding their bucket full go to the skiplist Q. Pops take the
+    // skiplist minimum whenever it is not past the cursor, else step the cursor over empty buckets, and let it jump
+    // to the key popped from the skiplist once the ring is empty. Buckets are retired through EpochDomain whatever the
+    // reclamation of Q.
+    //
+    // The cursor closes and drains a bucket when it moves past it. A push that published into a bucket the cursor
+    // already passed, and a pop moving the cursor past a bucket installed behind its back, drain it into the skiplist
+    // too, so no element is stranded behind the cursor.
+    template <typename K, uint32_t W = 1024, uint32_t C = 64, typename Q = Queue<K>>
+    class CalendarQueue
+    {
+        static_assert(std::is_integral<K>::value && std::is_unsigned<K>::value, "Key type must be unsigned integral");
+        static_assert(W > 0, "The window must hold at least one key");
+        static_assert(std::is_same<typename Q::Compare, std::less<K>>::value, "Buckets are ordered smallest first");
+        private:
+            struct Bucket
+            {
+                const K key;
+                typename TieBuckets<C>::template Bucket<K, std::allocator<K>, 1> items;
+
+                explicit Bucket(const K& key) : key(key)
+                {
+                }
+            };
+
+            std::atomic<K> cursor;
+            // Elements in the ring, a drain may decrement before the push of the same element incremented
+            std::atomic<int64_t> near;
+            std::atomic<Bucket*> ring[W];
+            Q skiplist;
+
+            static void DeleteBucket(void* bucket)
+            {
+                delete static_cast<Bucket*>(bucket);
+            }
+
+            // Closes the bucket and moves whatever finished its push to the skiplist
+            void Drain(Bucket* bucket)
+            {
+                bucket->items.Close();
+                int slot;
+                while ((slot = bucket->items.TryPop()) >= 0)
+                {
+                    this->skiplist.Push(*bucket->items.Get(slot));
+                    this->near--;
+                }
+            }
+
+            // The bucket of a key in the window, null if its slot still holds a key the cursor did not pass yet.
+            // A bucket the cursor passed is replaced, then drained.
+            Bucket* GetBucket(const K& priority)
+            {
+                std::atomic<Bucket*>& slot = this->ring[priority % W];
+                Bucket* current = slot.load();
+                while (!current || current->key != priority)
+                {
+                    if (current && current->key >= this->cursor.load())
+                    {
+                        return nullptr;
+                    }
+                    Bucket* created = new Bucket(priority);
+                    if (slot.compare_exchange_strong(current, created))
+                    {
+                        if (current)
+                        {
+                            this->Drain(current);
+                            EpochDomain::Get().Retire(current, &DeleteBucket);
+                        }
+                        return created;
+                    }
+                    delete created;
+                }
+                return current;
+            }
+
+            // Moves the cursor from from to to unless someone else moved it first. The buckets passed may have been
+            // installed after the caller found them empty, so they are drained.
+            void Advance(const K& from, const K& to)
+            {
+                K expected = from;
+                if (!this->cursor.compare_exchange_strong(expected, to))
+                {
+                    return;
+                }
+                K passed = static_cast<uint64_t>(to - from) < W ? to - from : W;
+                for (K i = 0; i < passed; ++i)
+                {
+                    Bucket* bucket = this->ring[(from + i) % W].load();
+                    if (bucket && bucket->key == from + i)
+                    {
+                        this->Drain(bucket);
+                    }
+                }
+            }
+
+        public:
+            CalendarQueue() : cursor(0), near(0)
+            {
+                for (uint32_t i = 0; i < W; ++i)
+                {
+                    this->ring[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            CalendarQueue(const CalendarQueue&) = delete;
+            CalendarQueue& operator=(const CalendarQueue&) = delete;
+
+            ~CalendarQueue()
+            {
+                for (uint32_t i = 0; i < W; ++i)
+                {
+                    delete this->ring[i].load();
+                }
+            }
+
+            void Push(const K& priority)
+            {
+                EpochGuard guard;
+                K cursor = this->cursor.load();
+                if (priority >= cursor && static_cast<uint64_t>(priority - cursor) < W)
+                {
+                    Bucket* bucket = this->GetBucket(priority);
+                    if (bucket && bucket->items.TryPush(priority))
+                    {
+                        this->near++;
+                        if (this->cursor.load() > priority)
+                        {
+                            this->Drain(bucket);
+                        }
+                        return;
+                    }
+                }
+                this->skiplist.Push(priority);
+            }
+
+            // Fails only if nothing finished its push. Like TryPopStrong of Queue, races may hand out a slightly larger
+            // key than the smallest one.
+            bool TryPop(K& priority)
+            {
+                EpochGuard guard;
+                uint32_t steps = 0;
+                while (true)
+                {
+                    K cursor = this->cursor.load();
+                    // Checking the count first keeps pops off the skiplist while every key fits in the window
+                    K least = 0;
+                    bool far = this->skiplist.GetSize() != 0 && this->skiplist.TryPeek(least);
+                    if (far && least <= cursor)
+                    {
+                        if (this->skiplist.TryPopStrong(priority))
+                        {
+                            return true;
+                        }
+                        continue;
+                    }
+                    if (this->near.load() <= 0 || steps == W)
+                    {
+                        if (!far)
+                        {
+                            return false;
+                        }
+                        if (!this->skiplist.TryPopStrong(priority))
+                        {
+                            continue;
+                        }
+                        // The ring is empty, keys close to the popped one should land in it from now on
+                        if (steps < W && priority > cursor)
+                        {
+                            this->Advance(cursor, priority);
+                        }
+                        return true;
+                    }
+                    Bucket* bucket = this->ring[cursor % W].load();
+                    if (bucket && bucket->key == cursor)
+                    {
+                        int slot = bucket->items.TryPop();
+                        if (slot >= 0)
+                        {
+                            priority = *bucket->items.Get(slot);
+                            this->near--;
+                            return true;
+                        }
+                    }
+                    // Pushes still in flight in the bucket find the cursor past it and drain it themselves
+                    this->Advance(cursor, cursor + 1);
+                    ++steps;
+                }
+            }
+
+            uint64_t GetSize() const
+            {
+                int64_t near = this->near.load();
+                return this->skiplist.GetSize() + static_cast<uint64_t>(near > 0 ? near : 0);
+            }
+    };
+
+    // Laid out like CalendarQueue, the ring buckets hold key value pairs and the skiplist is a KVQueue.
+    template <typename K, typename V, uint32_t W = 1024, uint32_t C = 64, typename Q = KVQueue<K, V>>
+    class KVCalendarQueue
+    {
+        static_assert(std::is_integral<K>::value && std::is_unsigned<K>::value, "Key type must be unsigned integral");
+        static_assert(W > 0, "The window must hold at least one key");
+        static_assert(std::is_same<typename Q::Compare, std::less<K>>::value, "Buckets are ordered smallest first");
+        private:
+            typedef std::pair<K, V> Item;
+
+            struct Bucket
+            {
+                const K key;
+                typename TieBuckets<C>::template Bucket<Item, std::allocator<Item>, 1> items;
+
+                explicit Bucket(const K& key) : key(key)
+                {
+                }
+            };
+
+            std::atomic<K> cursor;
+            // Elements in the ring, a drain may decrement before the push of the same element incremented
+            std::atomic<int64_t> near;
+            std::atomic<Bucket*> ring[W];
+            Q skiplist;
+
+            static void DeleteBucket(void* bucket)
+            {
+                delete static_cast<Bucket*>(bucket);
+            }
+
+            // Closes the bucket and moves whatever finished its push to the skiplist
+            void Drain(Bucket* bucket)
+            {
+                bucket->items.Close();
+                int slot;
+                while ((slot = bucket->items.TryPop()) >= 0)
+                {
+                    Item* item = bucket->items.Get(slot);
+                    this->skiplist.Emplace(item->first, std::move(item->second));
+                    this->near--;
+                }
+            }
+
+            // The bucket of a key in the window, null if its slot still holds a key the cursor did not pass yet.
+            // A bucket the cursor passed is replaced, then drained.
+            Bucket* GetBucket(const K& priority)
+            {
+                std::atomic<Bucket*>& slot = this->ring[priority % W];
+                Bucket* current = slot.load();
+                while (!current || current->key != priority)
+                {
+                    if (current && current->key >= this->cursor.load())
+                    {
+                        return nullptr;
+                    }
+                    Bucket* created = new Bucket(priority);
+                    if (slot.compare_exchange_strong(current, created))
+                    {
+                        if (current)
+                        {
+                            this->Drain(current);
+                            EpochDomain::Get().Retire(current, &DeleteBucket);
+                        }
+                        return created;
+                    }
+                    delete created;
+                }
+                return current;
+            }
+
+            // Moves the cursor from from to to unless someone else moved it first. The buckets passed may have been
+            // installed after the caller found them empty, so they are drained.
+            void Advance(const K& from, const K& to)
+            {
+                K expected = from;
+                if (!this->cursor.compare_exchange_strong(expected, to))
+                {
+                    return;
+                }
+                K passed = static_cast<uint64_t>(to - from) < W ? to - from : W;
+                for (K i = 0; i < passed; ++i)
+                {
+                    Bucket* bucket = this->ring[(from + i) % W].load();
+                    if (bucket && bucket->key == from + i)
+                    {
+                        this->Drain(bucket);
+                    }
+                }
+            }
+
+        public:
+            KVCalendarQueue() : cursor(0), near(0)
+            {
+                for (uint32_t i = 0; i < W; ++i)
+                {
+                    this->ring[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            KVCalendarQueue(const KVCalendarQueue&) = delete;
+            KVCalendarQueue& operator=(const KVCalendarQueue&) = delete;
+
+            ~KVCalendarQueue()
+            {
+                for (uint32_t i = 0; i < W; ++i)
+                {
+                    delete this->ring[i].load();
+                }
+            }
+
+            void Push(const K& priority)
+            {
+                this->Emplace(priority);
+            }
+
+            void Push(const K& priority, const V& data)
+            {
+                this->Emplace(priority, data);
+            }
+
+            void Push(const K& priority, V&& data)
+            {
+                this->Emplace(priority, std::move(data));
+            }
+
+            // Constructs the value in place from args, in a ring bucket or in a skiplist node
+            template <typename... Args>
+            void Emplace(const K& priority, Args&&... args)
+            {
+                EpochGuard guard;
+                K cursor = this->cursor.load();
+                if (priority >= cursor && static_cast<uint64_t>(priority - cursor) < W)
+                {
+                    Bucket* bucket = this->GetBucket(priority);
+                    if (bucket && bucket->items.TryPush(std::piecewise_construct, std::forward_as_tuple(priority),
+                                                        std::forward_as_tuple(std::forward<Args>(args)...)))
+                    {
+                        this->near++;
+                        if (this->cursor.load() > priority)
+                        {
+                            this->Drain(bucket);
+                        }
+                        return;
+                    }
+                }
+                this->skiplist.Emplace(priority, std::forward<Args>(args)...);
+            }
+
+            // Fails only if nothing finished its push. Like TryPopStrong of KVQueue, races may hand out a slightly
+            // larger key than the smallest one.
+            bool TryPop(K& priority, V& data)
+            {
+                EpochGuard guard;
+                uint32_t steps = 0;
+                while (true)
+                {
+                    K cursor = this->cursor.load();
+                    // Checking the count first keeps pops off the skiplist while every key fits in the window
+                    K least = 0;
+                    bool far = this->skiplist.GetSize() != 0 && this->skiplist.TryPeek(least);
+                    if (far && least <= cursor)
+                    {
+                        if (this->skiplist.TryPopStrong(priority, data))
+                        {
+                            return true;
+                        }
+                        continue;
+                    }
+                    if (this->near.load() <= 0 || steps == W)
+                    {
+                        if (!far)
+                        {
+                            return false;
+                        }
+                        if (!this->skiplist.TryPopStrong(priority, data))
+                        {
+                            continue;
+                        }
+                        // The ring is empty, keys close to the popped one should land in it from now on
+                        if (steps < W && priority > cursor)
+                        {
+                            this->Advance(cursor, priority);
+                        }
+                        return true;
+                    }
+                    Bucket* bucket = this->ring[cursor % W].load();
+                    if (bucket && bucket->key == cursor)
+                    {
+                        int slot = bucket->items.TryPop();
+                        if (slot >= 0)
+                        {
+                            Item* item = bucket->items.Get(slot);
+                            priority = item->first;
+                            data = std::move(item->second);
+                            this->near--;
+                            return true;
+                        }
+                    }
+                    // Pushes still in flight in the bucket find the cursor past it and drain it themselves
+                    this->Advance(cursor, cursor + 1);
+                    ++steps;
+                }
+            }
+
+            uint64_t GetSize() const
+            {
+                int64_t near = this->near.load();
+                return this->skiplist.GetSize() + static_cast<uint64_t>(near > 0 ? near : 0);
+            }
+    };
+
+    // Picks CalendarQueue for unsigned integral keys and Queue for any other key
+    template <typename K, bool = std::is_integral<K>::value && std::is_unsigned<K>::value>
+    struct QueueFor
+    {
+        typedef Queue<K> Type;
+    };
+
+    template <typename K>
+    struct QueueFor<K, true>
+    {
+        typedef CalendarQueue<K> Type;
+    };
+
+    template <typename K, typename V, bool = std::is_integral<K>::value && std::is_unsigned<K>::value>
+    struct KVQueueFor
+    {
+        typedef KVQueue<K, V> Type;
+    };
+
+    template <typename K, typename V>
+    struct KVQueueFor<K, V, true>
+    {
+        typedef KVCalendarQueue<K, V> Type;
+    };
+}
+
+#endif // __CSLPQ_CALENDAR_HPP__
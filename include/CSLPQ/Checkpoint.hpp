@@ -0,0 +1,141 @@
+#ifndef __CSLPQ_CHECKPOINT_HPP__
+#define __CSLPQ_CHECKPOINT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CSLPQ
+{
+    // Starts a checkpoint written by Serialize. The elements follow in order, each the raw bytes of its key and then
+    // of its value, back to back without padding, so a checkpoint only restores on a machine with the same byte order
+    // and type layouts. Queues of keys only write a value size of 0.
+    struct CheckpointHeader
+    {
+        static const uint32_t current_version = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t key_size;
+        uint32_t value_size;
+        uint32_t reserved;
+
+        static CheckpointHeader For(uint32_t key_size, uint32_t value_size)
+        {
+            CheckpointHeader header;
+            std::memcpy(header.magic, "CSLPQ\0\0\0", sizeof(header.magic));
+            header.version = current_version;
+            header.key_size = key_size;
+            header.value_size = value_size;
+            header.reserved = 0;
+            return header;
+        }
+
+        bool Matches(const CheckpointHeader& other) const
+        {
+            return !std::memcmp(this->magic, other.magic, sizeof(this->magic)) && this->version == other.version &&
+                   this->key_size == other.key_size && this->value_size == other.value_size;
+        }
+
+        size_t RecordSize() const
+        {
+            return this->key_size + this->value_size;
+        }
+    };
+
+    // A read only view of a whole file for Restore, mapped into memory where mmap exists and read into a buffer
+    // elsewhere. Invalid if the file could not be opened.
+    class MappedFile
+    {
+        private:
+            const char* data;
+            size_t size;
+            std::vector<char> buffer;
+
+            static const char* Empty()
+            {
+                static const char empty = 0;
+                return &empty;
+            }
+
+        public:
+            explicit MappedFile(const std::string& path) : data(nullptr), size(0), buffer()
+            {
+#if defined(__unix__) || defined(__APPLE__)
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                {
+                    return;
+                }
+                struct stat status;
+                if (::fstat(fd, &status) == 0)
+                {
+                    // Empty files map to nothing but are valid
+                    this->data = Empty();
+                    if (status.st_size > 0)
+                    {
+                        void* mapped = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                        this->data = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+                        if (this->data)
+                        {
+                            // Read front to back exactly once
+                            ::madvise(mapped, status.st_size, MADV_SEQUENTIAL);
+                            this->size = status.st_size;
+                        }
+                    }
+                }
+                ::close(fd);
+#else
+                std::ifstream file(path.c_str(), std::ios::binary);
+                if (!file)
+                {
+                    return;
+                }
+                this->buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                this->data = this->buffer.empty() ? Empty() : this->buffer.data();
+                this->size = this->buffer.size();
+#endif
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ~MappedFile()
+            {
+#if defined(__unix__) || defined(__APPLE__)
+                if (this->size)
+                {
+                    ::munmap(const_cast<char*>(this->data), this->size);
+                }
+#endif
+            }
+
+            bool IsValid() const
+            {
+                return this->data != nullptr;
+            }
+
+            const void* Data() const
+            {
+                return this->data;
+            }
+
+            size_t Size() const
+            {
+                return this->size;
+            }
+    };
+}
+
+#endif // __CSLPQ_CHECKPOINT_HPP__
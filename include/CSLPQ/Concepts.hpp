@@ -1,6 +1,7 @@
 #ifndef __CSLPQ_CONCEPT_HPP__
 #define __CSLPQ_CONCEPT_HPP__
 
+#include <functional>
 #include <type_traits>
 #include <sstream>
 
@@ -27,6 +28,29 @@ namespace CSLPQ
     template <class T, class EqualTo = T>
     struct is_comparable : is_comparable_impl<T, EqualTo>::type {};
 
+    template <class T, class Compare>
+    struct is_ordered_by_impl
+    {
+        template <class U, class C>
+        static auto test(U*) -> decltype(
+                static_cast<bool>(std::declval<const C&>()(std::declval<const U&>(), std::declval<const U&>())),
+                std::true_type());
+
+        template <class, class>
+        static auto test(...) -> std::false_type;
+
+        using type = typename std::integral_constant<bool, decltype(test<T, Compare>(0))::value &&
+                                                           std::is_default_constructible<Compare>::value>::type;
+    };
+
+    // Whether a default constructed Compare orders keys of type T. The default std::less<T> keeps asking for all the
+    // comparison operators, as before comparators could be chosen.
+    template <class T, class Compare>
+    struct is_ordered_by : is_ordered_by_impl<T, Compare>::type {};
+
+    template <class T>
+    struct is_ordered_by<T, std::less<T>> : is_comparable<T> {};
+
     template <class T>
     struct is_printable_impl
     {
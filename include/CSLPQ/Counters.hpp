@@ -0,0 +1,108 @@
+#ifndef __CSLPQ_COUNTERS_HPP__
+#define __CSLPQ_COUNTERS_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+namespace CSLPQ
+{
+    // Threads are numbered round robin as they first touch a striped counter
+    inline uint32_t StripeIndex()
+    {
+        static std::atomic<uint32_t> next(0);
+        static thread_local uint32_t index = next++;
+        return index;
+    }
+
+    // One atomic count every push and pop updates, exact but a cache line all threads write. This is the default.
+    // Counts may dip below zero, a pop can be counted before the push of the same element.
+    class ExactCounter
+    {
+        private:
+            std::atomic<int64_t> value;
+
+        public:
+            ExactCounter() : value(0)
+            {
+            }
+
+            ExactCounter(const ExactCounter&) = delete;
+            ExactCounter& operator=(const ExactCounter&) = delete;
+
+            // Returns the count before adding
+            int64_t Add(int64_t delta)
+            {
+                return this->value.fetch_add(delta);
+            }
+
+            int64_t Get() const
+            {
+                return this->value.load();
+            }
+
+            // Not thread safe, for moving queues
+            void Set(int64_t value)
+            {
+                this->value.store(value);
+            }
+    };
+
+    // S counts on cache lines of their own, each thread adds to the stripe of its index. Adding only contends with
+    // threads sharing the stripe, reading sums the stripes without a snapshot, so counts seen by readers are
+    // approximate while other threads push and pop. Heap allocated queues may not be over aligned, so stripes are
+    // padded instead.
+    template <uint32_t S = 16>
+    class StripedCounter
+    {
+        static_assert(S > 0, "There must be at least one stripe");
+        private:
+            struct Stripe
+            {
+                std::atomic<int64_t> value;
+                char padding_after[64 - sizeof(std::atomic<int64_t>)];
+            };
+
+            char padding_before[64];
+            Stripe stripes[S];
+
+        public:
+            StripedCounter()
+            {
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    this->stripes[i].value.store(0, std::memory_order_relaxed);
+                }
+            }
+
+            StripedCounter(const StripedCounter&) = delete;
+            StripedCounter& operator=(const StripedCounter&) = delete;
+
+            // Returns the count of the stripe before adding, not the total
+            int64_t Add(int64_t delta)
+            {
+                return this->stripes[StripeIndex() % S].value.fetch_add(delta);
+            }
+
+            int64_t Get() const
+            {
+                int64_t total = 0;
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    total += this->stripes[i].value.load();
+                }
+                return total;
+            }
+
+            // Not thread safe, for moving queues
+            void Set(int64_t value)
+            {
+                this->stripes[0].value.store(value);
+                for (uint32_t i = 1; i < S; ++i)
+                {
+                    this->stripes[i].value.store(0);
+                }
+            }
+    };
+}
+
+#endif // __CSLPQ_COUNTERS_HPP__
@@ -0,0 +1,29 @@
+#ifndef __CSLPQ_DELETION_HPP__
+#define __CSLPQ_DELETION_HPP__
+
+#include <cstdint>
+
+namespace CSLPQ
+{
+    // Every pop first unlinks the nodes popped before it, so every pop writes to the links of the head. This is the
+    // default.
+    struct EagerDeletion
+    {
+        static const uint32_t threshold = 0;
+    };
+
+    // Pops only mark their node and walk over the marked prefix of the bottom level. Once a pop walks over B marked
+    // nodes it unlinks the whole prefix with one CAS per level, so the links of the head are written about once per B
+    // pops instead of on every pop. Each pop reads up to B more links, which is cheap with EpochReclamation and costs
+    // a reference count update per link with SharedReclamation. Pushes whose search passes through the prefix still
+    // unlink what they pass, they need a live predecessor to link after.
+    template <uint32_t B = 32>
+    struct LazyDeletion
+    {
+        static_assert(B > 0, "The prefix must be allowed at least one marked node");
+
+        static const uint32_t threshold = B;
+    };
+}
+
+#endif // __CSLPQ_DELETION_HPP__
@@ -0,0 +1,505 @@
+#ifndef __CSLPQ_ELIMINATION_HPP__
+#define __CSLPQ_ELIMINATION_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Parking.hpp"
+#include "Queue.hpp"
+#include "Random.hpp"
+
+namespace CSLPQ
+{
+    // S slots through which pushing threads hand elements to popping threads directly. A pop waits in a free slot for
+    // a while, a push or a combining pop that finds it waiting claims the slot, constructs the element in it and marks
+    // it full, and the pop moves the element out and frees the slot. A pop that gives up first takes its slot back
+    // with a CAS, so every element handed over is taken exactly once.
+    template <typename Item, uint32_t S>
+    class Exchanger
+    {
+        static_assert(S > 0, "There must be at least one slot");
+        private:
+            static const uint32_t free = 0;
+            static const uint32_t waiting = 1;
+            static const uint32_t busy = 2;
+            static const uint32_t full = 3;
+            static const uint32_t spin_count = 256;
+
+            // Padded on both sides, so that pops waiting in neighbouring slots don't share a cache line
+            struct Slot
+            {
+                char padding_before[64];
+                std::atomic<uint32_t> state;
+                typename std::aligned_storage<sizeof(Item), alignof(Item)>::type storage;
+                // Elements handed over by pushes and by combining pops, counted by whoever filled the slot
+                std::atomic<uint64_t> eliminated;
+                std::atomic<uint64_t> combined;
+
+                Slot() : state(free), eliminated(0), combined(0)
+                {
+                }
+
+                Item* Get()
+                {
+                    return reinterpret_cast<Item*>(&this->storage);
+                }
+            };
+
+            Slot slots[S];
+            char padding_after[64];
+
+        public:
+            Exchanger()
+            {
+            }
+
+            Exchanger(const Exchanger&) = delete;
+            Exchanger& operator=(const Exchanger&) = delete;
+
+            ~Exchanger()
+            {
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    if (this->slots[i].state.load() == full)
+                    {
+                        this->slots[i].Get()->~Item();
+                    }
+                }
+            }
+
+            // Waits in a random slot and passes an element handed over to take as an rvalue, false if none came. Fails
+            // right away if the slot is taken.
+            template <typename F>
+            bool Wait(F take)
+            {
+                Slot& slot = this->slots[ThreadRandom::Get().Next(S)];
+                uint32_t expected = free;
+                if (!slot.state.compare_exchange_strong(expected, waiting))
+                {
+                    return false;
+                }
+                for (uint32_t i = 0; i < spin_count && slot.state.load() == waiting; ++i)
+                {
+                    CpuRelax();
+                }
+                expected = waiting;
+                if (slot.state.compare_exchange_strong(expected, free))
+                {
+                    return false;
+                }
+                // Claimed before giving up, the element is on its way unless constructing it throws, which puts the slot
+                // back to waiting and lets this pop give up after all
+                while (true)
+                {
+                    uint32_t state = slot.state.load();
+                    if (state == full)
+                    {
+                        break;
+                    }
+                    expected = waiting;
+                    if (state == waiting && slot.state.compare_exchange_strong(expected, free))
+                    {
+                        return false;
+                    }
+                    CpuRelax();
+                }
+                take(std::move(*slot.Get()));
+                slot.Get()->~Item();
+                slot.state.store(free);
+                return true;
+            }
+
+            // A random slot if a pop waits in it, -1 otherwise. Only a hint, the pop may give up before Fill.
+            int Waiter() const
+            {
+                uint32_t index = ThreadRandom::Get().Next(S);
+                return this->slots[index].state.load() == waiting ? static_cast<int>(index) : -1;
+            }
+
+            // Pops waiting in any slot, a snapshot
+            uint32_t Waiters() const
+            {
+                uint32_t count = 0;
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    count += this->slots[i].state.load() == waiting;
+                }
+                return count;
+            }
+
+            // Hands an element to the pop waiting in slot index, false if it gave up already. args are only used on
+            // success.
+            template <typename... Args>
+            bool Fill(uint32_t index, bool combining, Args&&... args)
+            {
+                Slot& slot = this->slots[index];
+                uint32_t expected = waiting;
+                if (!slot.state.compare_exchange_strong(expected, busy))
+                {
+                    return false;
+                }
+                try
+                {
+                    new (&slot.storage) Item(std::forward<Args>(args)...);
+                }
+                catch (...)
+                {
+                    // The pop keeps waiting, or gives up, as if nobody came
+                    slot.state.store(waiting);
+                    throw;
+                }
+                (combining ? slot.combined : slot.eliminated).fetch_add(1, std::memory_order_relaxed);
+                slot.state.store(full);
+                return true;
+            }
+
+            // Like Fill, to whichever slot a pop waits in
+            template <typename... Args>
+            bool FillAny(bool combining, Args&&... args)
+            {
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    if (this->slots[i].state.load() == waiting && this->Fill(i, combining, std::forward<Args>(args)...))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            uint64_t GetEliminated() const
+            {
+                uint64_t count = 0;
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    count += this->slots[i].eliminated.load(std::memory_order_relaxed);
+                }
+                return count;
+            }
+
+            uint64_t GetCombined() const
+            {
+                uint64_t count = 0;
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    count += this->slots[i].combined.load(std::memory_order_relaxed);
+                }
+                return count;
+            }
+    };
+
+    // A queue behind an elimination layer of S slots, for many threads pushing keys near the minimum while others pop.
+    // A pop first tries TryPop on the queue. If that fails, because the queue was empty or another pop won the first
+    // node, it waits a moment in a random slot. A push whose key is no larger than the minimum of the queue and that
+    // finds a pop waiting hands the key over and never touches the skiplist, the key would have been the next one
+    // popped anyway. A pop that waited in vain while other pops wait too combines: it takes a combining flag, pops one
+    // key for each of them and itself in a single walk with TryPopN and hands them out. Keys the others gave up on in
+    // the meantime are pushed back. Otherwise it falls back to TryPopStrong, so pops only fail if nothing is left.
+    template <typename K, uint32_t S = 8, typename Q = Queue<K>>
+    class EliminationQueue
+    {
+        private:
+            typedef typename Q::Compare Compare;
+
+            Q queue;
+            Exchanger<K, S> exchanger;
+            char padding_before[64];
+            std::atomic<bool> combining;
+            char padding_after[64];
+
+            // Pushes of a key not ordered after the minimum may skip the queue, any key may if it is empty
+            bool TryEliminate(const K& priority)
+            {
+                int index = this->exchanger.Waiter();
+                if (index < 0)
+                {
+                    return false;
+                }
+                K least = K();
+                if (this->queue.TryPeek(least) && Compare()(least, priority))
+                {
+                    return false;
+                }
+                return this->exchanger.Fill(index, false, priority);
+            }
+
+            bool Wait(K& priority)
+            {
+                return this->exchanger.Wait([&](K&& key)
+                {
+                    priority = std::move(key);
+                });
+            }
+
+            // Pushes back the keys of batch from first on, first is left at the one whose push threw if any does
+            void PushBack(std::vector<K>& batch, size_t& first)
+            {
+                for (; first < batch.size(); ++first)
+                {
+                    this->queue.Push(batch[first]);
+                }
+            }
+
+            bool Combine(K& priority)
+            {
+                uint32_t waiters = this->exchanger.Waiters();
+                if (!waiters || this->combining.exchange(true))
+                {
+                    return false;
+                }
+                // The first key is kept for this pop, the others go to pops waiting in the slots
+                std::vector<K> batch;
+                size_t next = 1;
+                try
+                {
+                    batch.reserve(waiters + 1);
+                    this->queue.TryPopN(std::back_inserter(batch), waiters + 1);
+                    while (next < batch.size() && this->exchanger.FillAny(true, std::move(batch[next])))
+                    {
+                        ++next;
+                    }
+                    this->PushBack(batch, next);
+                }
+                catch (...)
+                {
+                    // Keys not handed out yet, the one kept for this pop included, go back to the queue
+                    this->combining.store(false);
+                    if (!batch.empty())
+                    {
+                        this->queue.Push(batch[0]);
+                    }
+                    this->PushBack(batch, next);
+                    throw;
+                }
+                this->combining.store(false);
+                if (batch.empty())
+                {
+                    return false;
+                }
+                priority = std::move(batch[0]);
+                return true;
+            }
+
+        public:
+            EliminationQueue() : combining(false)
+            {
+            }
+
+            EliminationQueue(const EliminationQueue&) = delete;
+            EliminationQueue& operator=(const EliminationQueue&) = delete;
+
+            void Push(const K& priority)
+            {
+                if (!this->TryEliminate(priority))
+                {
+                    this->queue.Push(priority);
+                }
+            }
+
+            // Goes to the queue as a whole, so it keeps the batching of Queue::PushBulk
+            template <typename It>
+            void PushBulk(It first, It last)
+            {
+                this->queue.PushBulk(first, last);
+            }
+
+            // Fails only if there is nothing to pop
+            bool TryPop(K& priority)
+            {
+                return this->queue.TryPop(priority) || this->Wait(priority) || this->Combine(priority) ||
+                       this->queue.TryPopStrong(priority);
+            }
+
+            bool TryPeek(K& priority)
+            {
+                return this->queue.TryPeek(priority);
+            }
+
+            // Keys handed over never enter the queue and are not counted
+            uint64_t GetSize() const
+            {
+                return this->queue.GetSize();
+            }
+
+            // Pops served by a push through a slot
+            uint64_t GetEliminated() const
+            {
+                return this->exchanger.GetEliminated();
+            }
+
+            // Pops served by a combining pop through a slot
+            uint64_t GetCombined() const
+            {
+                return this->exchanger.GetCombined();
+            }
+    };
+
+    // Laid out like EliminationQueue, over a KVQueue. Values are moved through the slots.
+    template <typename K, typename V, uint32_t S = 8, typename Q = KVQueue<K, V>>
+    class KVEliminationQueue
+    {
+        private:
+            typedef typename Q::Compare Compare;
+            typedef std::pair<K, V> Item;
+
+            Q queue;
+            Exchanger<Item, S> exchanger;
+            char padding_before[64];
+            std::atomic<bool> combining;
+            char padding_after[64];
+
+            template <typename... Args>
+            bool TryEliminate(const K& priority, Args&&... args)
+            {
+                int index = this->exchanger.Waiter();
+                if (index < 0)
+                {
+                    return false;
+                }
+                K least = K();
+                if (this->queue.TryPeek(least) && Compare()(least, priority))
+                {
+                    return false;
+                }
+                return this->exchanger.Fill(index, false, std::piecewise_construct, std::forward_as_tuple(priority),
+                                            std::forward_as_tuple(std::forward<Args>(args)...));
+            }
+
+            bool Wait(K& priority, V& data)
+            {
+                return this->exchanger.Wait([&](Item&& item)
+                {
+                    priority = item.first;
+                    data = std::move(item.second);
+                });
+            }
+
+            // Pushes back the elements of batch from first on, first is left at the one whose push threw if any does
+            void PushBack(std::vector<Item>& batch, size_t& first)
+            {
+                for (; first < batch.size(); ++first)
+                {
+                    this->queue.Push(batch[first].first, std::move(batch[first].second));
+                }
+            }
+
+            bool Combine(K& priority, V& data)
+            {
+                uint32_t waiters = this->exchanger.Waiters();
+                if (!waiters || this->combining.exchange(true))
+                {
+                    return false;
+                }
+                // The first element is kept for this pop, the others go to pops waiting in the slots
+                std::vector<Item> batch;
+                size_t next = 1;
+                try
+                {
+                    batch.reserve(waiters + 1);
+                    this->queue.TryPopN(std::back_inserter(batch), waiters + 1);
+                    while (next < batch.size() && this->exchanger.FillAny(true, std::move(batch[next])))
+                    {
+                        ++next;
+                    }
+                    this->PushBack(batch, next);
+                }
+                catch (...)
+                {
+                    // Elements not handed out yet, the one kept for this pop included, go back to the queue. One
+                    // whose move into a slot threw keeps whatever its move constructor left in it.
+                    this->combining.store(false);
+                    if (!batch.empty())
+                    {
+                        this->queue.Push(batch[0].first, std::move(batch[0].second));
+                    }
+                    this->PushBack(batch, next);
+                    throw;
+                }
+                this->combining.store(false);
+                if (batch.empty())
+                {
+                    return false;
+                }
+                priority = batch[0].first;
+                data = std::move(batch[0].second);
+                return true;
+            }
+
+        public:
+            KVEliminationQueue() : combining(false)
+            {
+            }
+
+            KVEliminationQueue(const KVEliminationQueue&) = delete;
+            KVEliminationQueue& operator=(const KVEliminationQueue&) = delete;
+
+            void Push(const K& priority)
+            {
+                this->Emplace(priority);
+            }
+
+            void Push(const K& priority, const V& data)
+            {
+                this->Emplace(priority, data);
+            }
+
+            void Push(const K& priority, V&& data)
+            {
+                this->Emplace(priority, std::move(data));
+            }
+
+            // args are forwarded to whichever of the slot and the queue takes the element, they are used once
+            template <typename... Args>
+            void Emplace(const K& priority, Args&&... args)
+            {
+                if (!this->TryEliminate(priority, std::forward<Args>(args)...))
+                {
+                    this->queue.Emplace(priority, std::forward<Args>(args)...);
+                }
+            }
+
+            // Goes to the queue as a whole, so it keeps the batching of KVQueue::PushBulk
+            template <typename It>
+            void PushBulk(It first, It last)
+            {
+                this->queue.PushBulk(first, last);
+            }
+
+            // Fails only if there is nothing to pop
+            bool TryPop(K& priority, V& data)
+            {
+                return this->queue.TryPop(priority, data) || this->Wait(priority, data) ||
+                       this->Combine(priority, data) || this->queue.TryPopStrong(priority, data);
+            }
+
+            bool TryPeek(K& priority)
+            {
+                return this->queue.TryPeek(priority);
+            }
+
+            // Elements handed over never enter the queue and are not counted
+            uint64_t GetSize() const
+            {
+                return this->queue.GetSize();
+            }
+
+            // Pops served by a push through a slot
+            uint64_t GetEliminated() const
+            {
+                return this->exchanger.GetEliminated();
+            }
+
+            // Pops served by a combining pop through a slot
+            uint64_t GetCombined() const
+            {
+                return this->exchanger.GetCombined();
+            }
+    };
+}
+
+#endif // __CSLPQ_ELIMINATION_HPP__
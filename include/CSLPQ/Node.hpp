@@ -1,46 +1,149 @@
 #ifndef __CSLPQ_NODE_HPP__
 #define __CSLPQ_NODE_HPP__
 
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "Buckets.hpp"
 #include "Concepts.hpp"
-#include "Pointers.hpp"
+#include "Reclamation.hpp"
 
 namespace CSLPQ
 {
-    template<typename K, int L>
-    class Node
+    // Whether links keep a copy of the key of the node they point to, for keys that load and store as a single word
+    template <typename K>
+    struct caches_key : std::integral_constant<bool, std::is_trivially_copyable<K>::value && sizeof(K) <= 8 &&
+                                                     (sizeof(K) & (sizeof(K) - 1)) == 0>
     {
-        static_assert(is_comparable<K>::value, "Key type must be totally ordered");
+    };
+
+    // A link of a node. For small trivially copyable keys it is followed by a copy of the key of the node it points
+    // to, written after every change of the link, so a search can compare against the successor on the cache line of
+    // the link it just loaded instead of loading the successor. The copy lags the link for a moment after a change
+    // and is never read for a null link, so it is only a hint. Two changes in a row may store their copies in the
+    // opposite order, so a change of a published link stores its copy sequentially consistent and then loads the
+    // link again, storing the key of whatever it points to by then until the two agree. The last copy stored is thus
+    // always followed by such a check, and the copy settles on the key of the node the link points to.
+    template <typename K, typename MASPtr, bool = caches_key<K>::value>
+    struct NodeLink
+    {
+        MASPtr next;
+
+        explicit NodeLink(const K&) : next()
+        {
+        }
+
+        void Cache(const K&, std::memory_order = std::memory_order_relaxed)
+        {
+        }
+
+        template <typename F>
+        bool TestCached(F) const
+        {
+            return false;
+        }
+    };
+
+    template <typename K, typename MASPtr>
+    struct NodeLink<K, MASPtr, true>
+    {
+        MASPtr next;
+        std::atomic<K> key;
+
+        explicit NodeLink(const K& priority) : next(), key(priority)
+        {
+        }
+
+        void Cache(const K& priority, std::memory_order order = std::memory_order_relaxed)
+        {
+            this->key.store(priority, order);
+        }
+
+        template <typename F>
+        bool TestCached(F test) const
+        {
+            return test(this->key.load(std::memory_order_relaxed));
+        }
+    };
+
+    // Nodes are variable height. The key and level are followed in the same block by exactly level links and then
+    // the inserting flag, so the key shares a cache line with the first links and the flag, written once by the
+    // pusher, sits behind the links traversals read. Small keys are also copied next to every link pointing at the
+    // node, see NodeLink. Nodes must be created in a block of Size(level) bytes. B is
+    // the bucket of keys tied with the key of the node, see Buckets.hpp.
+    template<typename K, int L, typename R = SharedReclamation,
+             typename B = NoBuckets::Bucket<K, std::allocator<K>>>
+    class alignas(16) Node : public R::NodeBase, private B
+    {
+        static_assert(alignof(K) <= 16, "Key type must not need more than 16 byte alignment");
         public:
-            typedef jss::shared_ptr<Node<K, L>> SPtr;
-            typedef jss::atomic_shared_ptr<Node<K, L>> ASPtr;
-            typedef jss::markable_atomic_shared_ptr<Node<K, L>> MASPtr;
+            typedef typename R::template Pointers<Node<K, L, R, B>>::SPtr SPtr;
+            typedef typename R::template Pointers<Node<K, L, R, B>>::MASPtr MASPtr;
 
         private:
+            typedef NodeLink<K, MASPtr> LinkType;
+
             K priority;
             int level;
-            MASPtr next[L];
-            std::atomic<bool> inserting;
+
+            LinkType* Links()
+            {
+                return reinterpret_cast<LinkType*>(this + 1);
+            }
+
+            const LinkType* Links() const
+            {
+                return reinterpret_cast<const LinkType*>(this + 1);
+            }
+
+            std::atomic<bool>* Inserting() const
+            {
+                return reinterpret_cast<std::atomic<bool>*>(const_cast<LinkType*>(this->Links() + this->level));
+            }
 
         public:
-            Node(const K& priority, int level) : priority(priority), level(level), inserting(true)
+            static size_t Size(int level)
+            {
+                return sizeof(Node) + level * sizeof(LinkType) + sizeof(std::atomic<bool>);
+            }
+
+            Node(const K& priority, int level) : R::NodeBase(level), priority(priority), level(level)
+            {
+                for (int i = 0; i < level; ++i)
+                {
+                    new (this->Links() + i) LinkType(priority);
+                }
+                new (this->Inserting()) std::atomic<bool>(true);
+            }
+
+            Node(const Node&) = delete;
+            Node& operator=(const Node&) = delete;
+
+            ~Node()
             {
+                for (int i = 0; i < this->level; ++i)
+                {
+                    this->Links()[i].~LinkType();
+                }
             }
 
             SPtr GetNextPointer(int level) const
             {
-                return this->next[level].load();
+                return this->Links()[level].next.load();
             }
 
             bool IsNextMarked(int level) const
             {
-                return this->next[level].is_marked();
+                return this->Links()[level].next.is_marked();
             }
 
             std::pair<SPtr , bool> GetNextPointerAndMark(int level) const
             {
-                return this->next[level].load_marked();
+                return this->Links()[level].next.load_marked();
             }
 
             int GetLevel() const
@@ -53,98 +156,194 @@ namespace CSLPQ
                 return this->priority;
             }
 
+            // The key of the node for slot -1, of a tie popped from that bucket slot otherwise
+            K GetPriority(int slot) const
+            {
+                return slot < 0 ? this->priority : *this->B::Get(slot);
+            }
+
+            template <typename... Args>
+            bool TryPushTie(Args&&... args)
+            {
+                return this->B::TryPush(std::forward<Args>(args)...);
+            }
+
+            int TryPopTie()
+            {
+                return this->B::TryPop();
+            }
+
+            // The first bucket slot from index on whose tie is not popped yet, -1 if there is none
+            int NextTie(uint32_t index) const
+            {
+                return this->B::Next(index);
+            }
+
+            bool CloseTies()
+            {
+                return this->B::Close();
+            }
+
             bool IsInserting() const
             {
-                return this->inserting.load();
+                return this->Inserting()->load();
+            }
+
+            // Passes the copy of the key of the node the link points to to test, false if links of this key type keep
+            // none. Only a hint, it may belong to a node the link pointed to a moment before or after the one loaded.
+            template <typename F>
+            bool TestNextPriority(int level, F test) const
+            {
+                return this->Links()[level].TestCached(test);
             }
 
             void SetNext(int level, SPtr node)
             {
-                this->next[level] = node;
+                if (caches_key<K>::value && node)
+                {
+                    this->Links()[level].Cache(node->GetPriority());
+                }
+                this->Links()[level].next = node;
             }
 
             void SetNextMark(int level)
             {
-                this->next[level].set_mark();
+                this->Links()[level].next.set_mark();
             }
 
             bool TestAndSetMark(int level, SPtr& expected)
             {
-                return this->next[level].test_and_set_mark(expected);
+                return this->Links()[level].next.test_and_set_mark(expected);
             }
 
             bool CompareExchange(int level, SPtr& old_value, SPtr new_value)
             {
-                return this->next[level].compare_exchange_weak(old_value, new_value);
+                if (!caches_key<K>::value || !new_value)
+                {
+                    return this->Links()[level].next.compare_exchange_weak(old_value, new_value);
+                }
+                K priority = new_value->GetPriority();
+                if (!this->Links()[level].next.compare_exchange_weak(old_value, new_value))
+                {
+                    return false;
+                }
+                // Another change of the link may have stored its copy before this one, see NodeLink
+                SPtr cached = new_value;
+                while (true)
+                {
+                    this->Links()[level].Cache(priority, std::memory_order_seq_cst);
+                    SPtr current = this->Links()[level].next.load();
+                    if (!current || current == cached)
+                    {
+                        return true;
+                    }
+                    priority = current->GetPriority();
+                    cached = current;
+                }
             }
 
             void SetDoneInserting()
             {
-                this->inserting.store(false);
+                this->Inserting()->store(false);
+            }
+
+            // Only for a node moved to another queue, before it is linked there
+            void SetInserting()
+            {
+                this->Inserting()->store(true);
             }
     };
 
-    template<typename K, typename V, int L>
-    class KVNode
+    // Laid out like Node, the value follows the inserting flag. Ties are kept as key value pairs.
+    template<typename K, typename V, int L, typename R = SharedReclamation,
+             typename B = NoBuckets::Bucket<std::pair<K, V>, std::allocator<K>>>
+    class alignas(16) KVNode : public R::NodeBase, private B
     {
-        static_assert(is_comparable<K>::value, "Key type must be totally ordered");
         static_assert(std::is_move_constructible<V>::value || std::is_copy_constructible<V>::value ||
                       std::is_default_constructible<V>::value || std::is_fundamental<V>::value, 
                       "Value type must be fundamental, or default constructible, or copy or move constructible");
+        static_assert(alignof(K) <= 16 && alignof(V) <= 16,
+                      "Key and value types must not need more than 16 byte alignment");
         public:
-            typedef jss::shared_ptr<KVNode<K, V, L>> SPtr;
-            typedef jss::atomic_shared_ptr<KVNode<K, V, L>> ASPtr;
-            typedef jss::markable_atomic_shared_ptr<KVNode<K, V, L>> MASPtr;
+            typedef typename R::template Pointers<KVNode<K, V, L, R, B>>::SPtr SPtr;
+            typedef typename R::template Pointers<KVNode<K, V, L, R, B>>::MASPtr MASPtr;
 
         private:
+            typedef NodeLink<K, MASPtr> LinkType;
+
             K priority;
-            V data;
             int level;
-            MASPtr next[L];
-            std::atomic<bool> inserting;
 
-        public:
-            template <typename T = V>
-            KVNode(const K& priority, int level, 
-                   typename std::enable_if<std::is_default_constructible<T>::value, int>::type = 0) : priority(priority),
-                   data(V()), level(level), inserting(true)
+            LinkType* Links()
+            {
+                return reinterpret_cast<LinkType*>(this + 1);
+            }
+
+            const LinkType* Links() const
+            {
+                return reinterpret_cast<const LinkType*>(this + 1);
+            }
+
+            std::atomic<bool>* Inserting() const
+            {
+                return reinterpret_cast<std::atomic<bool>*>(const_cast<LinkType*>(this->Links() + this->level));
+            }
+
+            static size_t DataOffset(int level)
+            {
+                size_t end = sizeof(KVNode) + level * sizeof(LinkType) + sizeof(std::atomic<bool>);
+                return (end + alignof(V) - 1) / alignof(V) * alignof(V);
+            }
+
+            V* Data() const
             {
+                return reinterpret_cast<V*>(reinterpret_cast<char*>(const_cast<KVNode*>(this)) +
+                                            DataOffset(this->level));
             }
 
-            template <typename T = V>
-            KVNode(const K& priority, const V& value, int level, 
-                   typename std::enable_if<std::is_fundamental<T>::value, int>::type = 0) : priority(priority), 
-                   data(value), level(level), inserting(true)
+        public:
+            static size_t Size(int level)
             {
+                return DataOffset(level) + sizeof(V);
             }
 
-            template <typename T = V>
-            KVNode(const K& priority, const V& value, int level,
-                   typename std::enable_if<std::is_move_constructible<T>::value && !std::is_fundamental<T>::value, int>::type = 0) : 
-                   priority(priority), data(std::move(value)), level(level), inserting(true)
+            // The value is constructed in place from args, no args value initializes it
+            template <typename... Args>
+            KVNode(const K& priority, int level, Args&&... args) : R::NodeBase(level), priority(priority), level(level)
             {
+                new (this->Data()) V(std::forward<Args>(args)...);
+                for (int i = 0; i < level; ++i)
+                {
+                    new (this->Links() + i) LinkType(priority);
+                }
+                new (this->Inserting()) std::atomic<bool>(true);
             }
 
-            template <typename T = V>
-            KVNode(const K& priority, const V& value, int level,
-                   typename std::enable_if<std::is_copy_constructible<T>::value && !std::is_move_constructible<T>::value, int>::type = 0) : 
-                   priority(priority), data(value), level(level), inserting(true)
+            KVNode(const KVNode&) = delete;
+            KVNode& operator=(const KVNode&) = delete;
+
+            ~KVNode()
             {
+                for (int i = 0; i < this->level; ++i)
+                {
+                    this->Links()[i].~LinkType();
+                }
+                this->Data()->~V();
             }
 
             SPtr GetNextPointer(int level) const
             {
-                return this->next[level].load();
+                return this->Links()[level].next.load();
             }
 
             bool IsNextMarked(int level) const
             {
-                return this->next[level].is_marked();
+                return this->Links()[level].next.is_marked();
             }
 
             std::pair<SPtr , bool> GetNextPointerAndMark(int level) const
             {
-                return this->next[level].load_marked();
+                return this->Links()[level].next.load_marked();
             }
 
             int GetLevel() const
@@ -157,39 +356,128 @@ namespace CSLPQ
                 return this->priority;
             }
 
-            V GetData() const
+            const V& GetData() const
+            {
+                return *this->Data();
+            }
+
+            // The value of the node for slot -1, of the tie in that bucket slot otherwise
+            const V& GetData(int slot) const
+            {
+                return slot < 0 ? *this->Data() : this->B::Get(slot)->second;
+            }
+
+            // Only for the thread that won the mark of level 0
+            V&& MoveData()
             {
-                return this->data;
+                return std::move(*this->Data());
+            }
+
+            // The key of the node for slot -1, of a tie popped from that bucket slot otherwise
+            K GetPriority(int slot) const
+            {
+                return slot < 0 ? this->priority : this->B::Get(slot)->first;
+            }
+
+            // Only for the thread that popped the slot, or won the mark of level 0 for slot -1
+            V&& MoveData(int slot)
+            {
+                if (slot < 0)
+                {
+                    return std::move(*this->Data());
+                }
+                return std::move(this->B::Get(slot)->second);
+            }
+
+            template <typename... Args>
+            bool TryPushTie(Args&&... args)
+            {
+                return this->B::TryPush(std::forward<Args>(args)...);
+            }
+
+            int TryPopTie()
+            {
+                return this->B::TryPop();
+            }
+
+            // The first bucket slot from index on whose tie is not popped yet, -1 if there is none
+            int NextTie(uint32_t index) const
+            {
+                return this->B::Next(index);
+            }
+
+            bool CloseTies()
+            {
+                return this->B::Close();
             }
 
             bool IsInserting() const
             {
-                return this->inserting.load();
+                return this->Inserting()->load();
+            }
+
+            // Passes the copy of the key of the node the link points to to test, false if links of this key type keep
+            // none. Only a hint, it may belong to a node the link pointed to a moment before or after the one loaded.
+            template <typename F>
+            bool TestNextPriority(int level, F test) const
+            {
+                return this->Links()[level].TestCached(test);
             }
 
             void SetNext(int level, SPtr node)
             {
-                this->next[level] = node;
+                if (caches_key<K>::value && node)
+                {
+                    this->Links()[level].Cache(node->GetPriority());
+                }
+                this->Links()[level].next = node;
             }
 
             void SetNextMark(int level)
             {
-                this->next[level].set_mark();
+                this->Links()[level].next.set_mark();
             }
 
             bool TestAndSetMark(int level, SPtr& expected)
             {
-                return this->next[level].test_and_set_mark(expected);
+                return this->Links()[level].next.test_and_set_mark(expected);
             }
 
             bool CompareExchange(int level, SPtr& old_value, SPtr new_value)
             {
-                return this->next[level].compare_exchange_weak(old_value, new_value);
+                if (!caches_key<K>::value || !new_value)
+                {
+                    return this->Links()[level].next.compare_exchange_weak(old_value, new_value);
+                }
+                K priority = new_value->GetPriority();
+                if (!this->Links()[level].next.compare_exchange_weak(old_value, new_value))
+                {
+                    return false;
+                }
+                // Another change of the link may have stored its copy before this one, see NodeLink
+                SPtr cached = new_value;
+                while (true)
+                {
+                    this->Links()[level].Cache(priority, std::memory_order_seq_cst);
+                    SPtr current = this->Links()[level].next.load();
+                    if (!current || current == cached)
+                    {
+                        return true;
+                    }
+                    priority = current->GetPriority();
+                    cached = current;
+                }
             }
 
             void SetDoneInserting()
             {
-                this->inserting.store(false);
+                this->Inserting()->store(false);
+            }
+
+            // Only for a node moved to another queue, before it is linked there
+            void SetInserting()
+            {
+                this->Inserting()->store(true);
             }
     };
 }
@@ -0,0 +1,109 @@
+#ifndef __CSLPQ_NUMA_HPP__
+#define __CSLPQ_NUMA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace CSLPQ
+{
+    // What little the queues need to know about NUMA, read from sysfs and getcpu on Linux without linking libnuma.
+    // Elsewhere, or if any of it fails, the machine is a single node and everything here is a no op.
+    class NumaTopology
+    {
+        public:
+            static const uint32_t max_nodes = 64;
+
+        private:
+            static const uint32_t refresh_interval = 1024;
+
+            // The online list looks like "0" or "0-1,3", nodes are counted up to the highest id
+            static uint32_t ReadNodes()
+            {
+                uint32_t nodes = 1;
+#ifdef __linux__
+                std::ifstream online("/sys/devices/system/node/online");
+                std::string list;
+                if (!(online >> list))
+                {
+                    return nodes;
+                }
+                uint32_t id = 0;
+                for (size_t i = 0; i <= list.size(); ++i)
+                {
+                    if (i < list.size() && list[i] >= '0' && list[i] <= '9')
+                    {
+                        id = id * 10 + (list[i] - '0');
+                        continue;
+                    }
+                    if (id + 1 > nodes)
+                    {
+                        nodes = id + 1;
+                    }
+                    id = 0;
+                }
+#endif
+                return nodes < max_nodes ? nodes : max_nodes;
+            }
+
+        public:
+            static uint32_t Nodes()
+            {
+                static const uint32_t nodes = ReadNodes();
+                return nodes;
+            }
+
+            // The node the calling thread runs on. Cached per thread and asked again every refresh_interval calls,
+            // since threads may migrate.
+            static uint32_t CurrentNode()
+            {
+#ifdef __linux__
+                if (Nodes() < 2)
+                {
+                    return 0;
+                }
+                static thread_local uint32_t node = 0;
+                static thread_local uint32_t calls = 0;
+                if (calls++ % refresh_interval == 0)
+                {
+                    unsigned cpu = 0;
+                    unsigned current = 0;
+                    if (syscall(SYS_getcpu, &cpu, &current, nullptr) == 0)
+                    {
+                        node = current < Nodes() ? current : 0;
+                    }
+                }
+                return node;
+#else
+                return 0;
+#endif
+            }
+
+            // Asks the kernel to place the pages of a range starting at a page boundary on the node of the calling
+            // thread. Best effort, only pages not faulted in yet follow it.
+            static void BindLocal(void* address, size_t size)
+            {
+#if defined(__linux__) && defined(SYS_mbind)
+                if (Nodes() < 2)
+                {
+                    return;
+                }
+                const int preferred = 1;
+                unsigned long mask = 1UL << CurrentNode();
+                // The kernel reads one bit less than it is told
+                syscall(SYS_mbind, address, size, preferred, &mask, (unsigned long)max_nodes + 1, 0);
+#else
+                (void)address;
+                (void)size;
+#endif
+            }
+    };
+}
+
+#endif // __CSLPQ_NUMA_HPP__
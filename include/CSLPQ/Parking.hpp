@@ -0,0 +1,98 @@
+#ifndef __CSLPQ_PARKING_HPP__
+#define __CSLPQ_PARKING_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace CSLPQ
+{
+    inline void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#endif
+    }
+
+    // Spin then park until a condition holds. Waiters announce themselves before their last look at the condition
+    // and notifiers look for waiters after changing it, so either the waiter sees the change or the notifier sees the
+    // waiter. Notifying without waiters is a single load.
+    class Parker
+    {
+        private:
+            static const uint32_t spin_count = 128;
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::atomic<uint32_t> waiters;
+
+            template <typename P>
+            static bool Spin(P& ready)
+            {
+                for (uint32_t i = 0; i < spin_count; ++i)
+                {
+                    if (ready())
+                    {
+                        return true;
+                    }
+                    CpuRelax();
+                }
+                return ready();
+            }
+
+        public:
+            Parker() : waiters(0)
+            {
+            }
+
+            Parker(const Parker&) = delete;
+            Parker& operator=(const Parker&) = delete;
+
+            template <typename P>
+            void Wait(P ready)
+            {
+                if (Spin(ready))
+                {
+                    return;
+                }
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->waiters++;
+                this->condition.wait(lock, ready);
+                this->waiters--;
+            }
+
+            // Returns false if the deadline passed before the condition held
+            template <typename P, typename C, typename D>
+            bool WaitUntil(P ready, const std::chrono::time_point<C, D>& deadline)
+            {
+                if (Spin(ready))
+                {
+                    return true;
+                }
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->waiters++;
+                bool result = this->condition.wait_until(lock, deadline, ready);
+                this->waiters--;
+                return result;
+            }
+
+            void NotifyOne()
+            {
+                if (this->waiters.load())
+                {
+                    // Taking the lock orders the notification after a waiter that is between its last look at the
+                    // condition and going to sleep
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                    }
+                    this->condition.notify_one();
+                }
+            }
+    };
+}
+
+#endif // __CSLPQ_PARKING_HPP__
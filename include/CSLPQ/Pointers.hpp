@@ -41,12 +41,50 @@
 #define _JSS_ATOMIC_SHARED_PTR
 #include <atomic>
 #include <memory>
-#include <deque>
+#include <utility>
+#include <vector>
 #include "Atomic128.hpp"
 
 namespace jss{
     template<class T> class shared_ptr;
 
+    // Deleting a value may drop the last reference to the next one and so on, so a chain would be deleted by
+    // recursion as deep as it is long. The outermost deletion of a thread collects the ones it runs into in a vector
+    // on its own stack and runs them in a loop. Only a trivially destructible pointer to that vector is thread_local,
+    // so deletions still work once the thread_local objects of the thread were destroyed, like those of a static
+    // owner destroyed at exit.
+    class chain_deleter{
+    public:
+        typedef void (*function)(void*);
+
+        static void run(function f,void* p)
+        {
+            pending_type*& pending=active();
+            if(pending){
+                pending->emplace_back(f,p);
+                return;
+            }
+            pending_type local;
+            pending=&local;
+            f(p);
+            while(!local.empty()){
+                std::pair<function,void*> next=local.back();
+                local.pop_back();
+                next.first(next.second);
+            }
+            pending=nullptr;
+        }
+
+    private:
+        typedef std::vector<std::pair<function,void*>> pending_type;
+
+        static pending_type*& active()
+        {
+            thread_local pending_type* pending=nullptr;
+            return pending;
+        }
+    };
+
     struct shared_ptr_data_block_base{};
 
     template<class D>
@@ -69,19 +107,13 @@ namespace jss{
         template<typename T>
         void do_delete(T* p)
         {
-            thread_local std::deque<T*> to_delete;
-            thread_local bool deleting;
-
-            to_delete.emplace_back(p);
-            if(!deleting){
-                deleting=true;
-                while(!to_delete.empty()){
-                    T* dp=to_delete.back();
-                    to_delete.pop_back();
-                    delete dp;
-                }
-                deleting=false;
-            }
+            chain_deleter::run(&delete_value<T>,p);
+        }
+
+        template<typename T>
+        static void delete_value(void* p)
+        {
+            delete static_cast<T*>(p);
         }
     };
 
@@ -179,6 +211,11 @@ namespace jss{
 
         virtual void do_delete()=0;
 
+        virtual void destroy()
+        {
+            delete this;
+        }
+
         void delete_object()
         {
             do_delete();
@@ -188,7 +225,7 @@ namespace jss{
         void dec_weak_count()
         {
             if(weak_count.fetch_add(-1)==1){
-                delete this;
+                destroy();
             }
         }
 
@@ -318,9 +355,59 @@ namespace jss{
         }
     };
 
+    // A header followed in the same allocator block by its T, which may keep trailing storage of its own behind it
+    // (a variable number of links). The block size is only known at run time, so the header keeps it and frees the
+    // block itself. Destroying a value drops the links it holds, which may destroy the next value and so on, so
+    // chains are unrolled by chain_deleter. A weak count keeps the block alive until its deferred destruction ran.
+    template<class T,class A>
+    struct alignas(16) shared_ptr_header_trailing:
+            public shared_ptr_header_block<T*>{
+        typedef typename std::aligned_storage<16,16>::type unit_type;
+        typedef typename std::allocator_traits<A>::template rebind_alloc<unit_type> allocator_type;
+
+        std::size_t units;
+
+        T* value(){
+            return static_cast<T*>(get_base_ptr());
+        }
+
+        void* get_base_ptr()
+        {
+            return this+1;
+        }
+
+        explicit shared_ptr_header_trailing(std::size_t units_):
+                units(units_)
+        {}
+
+        void do_delete()
+        {
+            this->inc_weak_count();
+            chain_deleter::run(&destroy_value,this);
+        }
+
+        static void destroy_value(void* p)
+        {
+            shared_ptr_header_trailing* dp=static_cast<shared_ptr_header_trailing*>(p);
+            dp->value()->~T();
+            dp->dec_weak_count();
+        }
+
+        void destroy()
+        {
+            std::size_t count=units;
+            allocator_type allocator;
+            this->~shared_ptr_header_trailing();
+            allocator.deallocate(reinterpret_cast<unit_type*>(this),count);
+        }
+    };
+
     template<typename T,typename ... Args>
     shared_ptr<T> make_shared(Args&& ... args);
 
+    template<typename T,typename A,typename ... Args>
+    shared_ptr<T> allocate_shared_trailing(A const& allocator,std::size_t size,Args&& ... args);
+
     template<class T> class shared_ptr {
         private:
             T* ptr;
@@ -335,6 +422,8 @@ namespace jss{
 
             template<typename U,typename ... Args>
             friend shared_ptr<U> make_shared(Args&& ... args);
+            template<typename U,typename B,typename ... Args>
+            friend shared_ptr<U> allocate_shared_trailing(B const& allocator,std::size_t size,Args&& ... args);
 
             shared_ptr(shared_ptr_header_block_base* header_,unsigned index):
                     ptr(header_?header_->get_ptr<T>(index):nullptr),header(header_)
@@ -357,6 +446,11 @@ namespace jss{
                     ptr(header_->value()),header(header_)
             {}
 
+            template<typename A>
+            shared_ptr(shared_ptr_header_trailing<T,A>* header_):
+                    ptr(header_->value()),header(header_)
+            {}
+
             void clear()
             {
                 header=nullptr;
@@ -550,6 +644,26 @@ namespace jss{
                         static_cast<Args&&>(args)...));
     }
 
+    // size is the number of bytes the T needs including its trailing storage
+    template<typename T,typename A,typename ... Args>
+    shared_ptr<T> allocate_shared_trailing(A const&,std::size_t size,Args&& ... args){
+        typedef shared_ptr_header_trailing<T,A> header_type;
+        typedef typename header_type::unit_type unit_type;
+        std::size_t units=(sizeof(header_type)+size+sizeof(unit_type)-1)/sizeof(unit_type);
+        typename header_type::allocator_type allocator;
+        unit_type* block=allocator.allocate(units);
+        header_type* header=new(block) header_type(units);
+        try{
+            new(header->get_base_ptr()) T(static_cast<Args&&>(args)...);
+        }
+        catch(...){
+            header->~header_type();
+            allocator.deallocate(block,units);
+            throw;
+        }
+        return shared_ptr<T>(header);
+    }
+
 #ifdef _MSC_VER
     #define JSS_ASP_ALIGN_TO(alignment) __declspec(align(alignment))
 #ifdef _WIN64
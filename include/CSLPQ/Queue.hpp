@@ -1,46 +1,309 @@
 #ifndef __CSLPQ_QUEUE_HPP__
 #define __CSLPQ_QUEUE_HPP__
 
-#include <vector>
-#include <random>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <ostream>
 #include <tuple>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 
+#include "Checkpoint.hpp"
 #include "Concepts.hpp"
 #include "Node.hpp"
+#include "Parking.hpp"
+#include "Statistics.hpp"
+#include "Traits.hpp"
 
 namespace CSLPQ
 {
-    template<typename K, int L = 4>
+    template<typename K, int L = 31, typename T = DefaultTraits<K>>
     class Queue
     {
-        static_assert(is_comparable<K>::value, "Key type must be totally ordered");
+        static_assert(is_ordered_by<K, typename T::Compare>::value, "Key type must be totally ordered by Compare");
         private:
-            typedef jss::shared_ptr<Node<K, L + 1>> SPtr;
+            typedef typename T::LevelGenerator LevelGenerator;
+            typedef typename T::Reclamation Reclamation;
+            typedef typename T::Allocator Allocator;
+            typedef typename T::Counter Counter;
+            typedef typename T::Deletion Deletion;
+            typedef typename T::Statistics::template Counters<L + 1> Statistics;
+            typedef typename T::Ties::template Bucket<K, Allocator> Bucket;
+            typedef Node<K, L + 1, Reclamation, Bucket> NodeType;
+            typedef typename NodeType::SPtr SPtr;
+            typedef typename NodeType::MASPtr MASPtr;
+            typedef typename Reclamation::Guard Guard;
+            typedef std::array<SPtr, L + 1> Path;
 
-            const uint32_t max_size;
+            const uint64_t max_size;
             SPtr head;
-            std::atomic<uint32_t> size;
+            // A pop may be counted before the push of the same node, so the count can dip below zero
+            Counter size;
+            // Number of levels in use, searches start at its top instead of at L. Pushers raise it before linking a
+            // taller node, pops lower it when they find the top level empty. It is only a hint, a pusher always
+            // searches the levels of its own node.
+            std::atomic<uint32_t> height;
+            Parker not_empty;
+            Parker not_full;
+            Statistics statistics;
+            // The node last linked at the end of each level, so pushes of a new largest key skip the search
+            MASPtr tails[L + 1];
+
+            // Whether a key comes out before another, everything below reads as a min queue under this order
+            static bool Less(const K& a, const K& b)
+            {
+                return Compare()(a, b);
+            }
+
+            // Whether a search can stop at level before the successor of predecessor, on the copy of its key kept next
+            // to the link and without loading the successor. Never at the bottom level, where ties and pops need the
+            // exact successor.
+            static bool StopsBefore(const SPtr& predecessor, int64_t level, const K& priority)
+            {
+                return level && predecessor->TestNextPriority(level, [&](const K& next)
+                {
+                    return !Less(next, priority);
+                });
+            }
+
+            // Approximate with a striped counter, which is all the max_size bound needs
+            int64_t Count() const
+            {
+                return this->size.Get();
+            }
 
             void Wait()
             {
                 if (this->max_size)
                 {
-                    while (this->size >= this->max_size);
+                    this->not_full.Wait([this]() { return this->Count() < static_cast<int64_t>(this->max_size); });
+                }
+            }
+
+            void Pushed()
+            {
+                this->size.Add(1);
+                this->not_empty.NotifyOne();
+            }
+
+            void Popped()
+            {
+                this->size.Add(-1);
+                if (this->max_size)
+                {
+                    this->not_full.NotifyOne();
                 }
             }
 
             uint32_t GenerateRandomLevel()
             {
-                static std::random_device rd;
-                static std::mt19937 mt(rd());
-                static std::uniform_int_distribution<uint32_t> dist(1, L + 1);
+                return LevelGenerator::Generate(L + 1);
+            }
+
+            void RaiseHeight(uint32_t level)
+            {
+                uint32_t current = this->height.load();
+                while (current < level && !this->height.compare_exchange_weak(current, level))
+                {
+                }
+            }
+
+            // Called after finding the top level empty. A push that linked there in the meantime is seen by the check
+            // after lowering, or raises the height again itself once it linked.
+            void LowerHeight(uint32_t height)
+            {
+                uint32_t expected = height;
+                if (this->height.compare_exchange_strong(expected, height - 1) &&
+                    this->head->GetNextPointer(height - 1))
+                {
+                    this->RaiseHeight(height);
+                }
+            }
+
+            // A node with exactly level links
+            static SPtr MakeNode(const K& priority, int level)
+            {
+                return Reclamation::template Make<NodeType, Allocator>(NodeType::Size(level), priority, level);
+            }
+
+            // With tie buckets, pushes into the bucket of the first node of an equal key if there is one. Otherwise the
+            // search is left in the path, linking a new node can start from it as a hint.
+            template <typename... Args>
+            bool PushTie(const K& priority, Path& predecessors, Path& successors, bool& hinted, Args&&... args)
+            {
+                if (!Bucket::enabled)
+                {
+                    return false;
+                }
+                this->FindLastOfPriority(priority, 1, predecessors, successors, hinted);
+                hinted = true;
+                const SPtr& successor = successors[0];
+                if (successor && !Less(priority, successor->GetPriority()) &&
+                    successor->TryPushTie(std::forward<Args>(args)...))
+                {
+                    this->Pushed();
+                    return true;
+                }
+                return false;
+            }
+
+            // The first node from node on that is not marked at this level
+            SPtr SkipMarked(SPtr node, int level)
+            {
+                bool marked = false;
+                SPtr next;
+                while (node)
+                {
+                    std::tie(next, marked) = node->GetNextPointerAndMark(level);
+                    if (!marked)
+                    {
+                        break;
+                    }
+                    node = next;
+                }
+                return node;
+            }
+
+            // Called once a CAS unlinked the nodes from first up to, not including, last at this level
+            void ReleaseRun(SPtr first, const SPtr& last, int level)
+            {
+                while (first != last)
+                {
+                    SPtr next = first->GetNextPointer(level);
+                    Reclamation::template Unlinked<Allocator>(first);
+                    first = next;
+                }
+            }
+
+            // Pops the first node from node on that is neither marked nor still being inserted, returns it or nothing if
+            // no such node is left. A lost race looks at the same node again: it was either popped by someone else or
+            // its successor changed under the mark. slot is set to the bucket slot of a popped tie, or -1 if the node
+            // itself was popped.
+            SPtr Claim(SPtr node, int& slot)
+            {
+                bool marked = false;
+                SPtr successor;
+                while (node)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (marked)
+                    {
+                        node = successor;
+                        continue;
+                    }
+                    // Ties go first, the node itself only once its bucket is closed and drained
+                    slot = node->TryPopTie();
+                    if (slot < 0 && !node->IsInserting() && !node->CloseTies())
+                    {
+                        slot = node->TryPopTie();
+                        if (slot < 0)
+                        {
+                            // The rest of the bucket is still being pushed
+                            node = successor;
+                            continue;
+                        }
+                    }
+                    if (slot >= 0)
+                    {
+                        this->Popped();
+                        return node;
+                    }
+                    if (node->IsInserting())
+                    {
+                        this->statistics.Count(Event::Inserting);
+                        node = successor;
+                        continue;
+                    }
+
+                    for (uint32_t level = node->GetLevel() - 1; level >= 1; --level)
+                    {
+                        node->SetNextMark(level);
+                    }
+                    if (node->TestAndSetMark(0, successor))
+                    {
+                        this->Popped();
+                        return node;
+                    }
+                    this->statistics.Count(Event::LostMark);
+                }
+                return SPtr();
+            }
+
+            // Marks a node all the way down like a pop, true if this call won the mark of level 0. Only for nodes of
+            // handles, which are fully linked and never hold ties.
+            bool Remove(const SPtr& node)
+            {
+                for (uint32_t level = node->GetLevel() - 1; level >= 1; --level)
+                {
+                    node->SetNextMark(level);
+                }
+                bool marked = false;
+                SPtr successor;
+                while (true)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (marked)
+                    {
+                        return false;
+                    }
+                    if (node->TestAndSetMark(0, successor))
+                    {
+                        break;
+                    }
+                }
+                this->Popped();
+                // Unlinks it right away if it is the first of its key, otherwise searches and pops passing it do. The
+                // search is exact, one stopping on a copy of its key would not load the node and unlink it.
+                Path predecessors;
+                Path successors;
+                this->FindLastOfPriority(node->GetPriority(), node->GetLevel(), predecessors, successors, false, true);
+                return true;
+            }
 
-                return dist(mt);
+            // Walks to a live node picked uniformly among the first bound ones of the bottom level. Relaxed pops leave
+            // marked nodes behind anywhere in the front, so each step also unlinks the marked run it skips, otherwise
+            // they would pile up and every walk would land on them.
+            SPtr Spray(uint32_t bound)
+            {
+                uint64_t steps = bound > 1 ? ThreadRandom::Get().Next(bound) : 0;
+                SPtr node = this->head;
+                for (uint64_t step = 0; step <= steps; ++step)
+                {
+                    SPtr next = node->GetNextPointer(0);
+                    SPtr live = this->SkipMarked(next, 0);
+                    SPtr expected = next;
+                    if (live != next && node->CompareExchange(0, expected, live))
+                    {
+                        this->statistics.Count(Event::Snip);
+                        this->ReleaseRun(next, live, 0);
+                    }
+                    if (!live)
+                    {
+                        break;
+                    }
+                    node = live;
+                }
+                return node == this->head ? SPtr() : node;
             }
 
-            void FindLastOfPriority(const K& priority, std::vector<SPtr>& predecessors,
-                                    std::vector<SPtr>& successors)
+            // With hinted set, predecessors and successors hold the path of an earlier search for a priority no larger
+            // than this one. Levels where that path still brackets the priority keep it, a link that changed since only
+            // fails the CAS of the caller, which then searches without a hint. The levels below start from whichever of
+            // the hint and the node the level above ended at is further. The search covers at least levels levels and
+            // at most the height, levels above are left empty in the path. Unless exact is set, levels above the bottom
+            // stop on the copy of the key of the successor kept next to its link where the node has one, see NodeLink.
+            // Such a copy lags the link only until the change that left it stale finished, see NodeLink. Meanwhile a
+            // level may stop before a successor smaller than the priority, which callers linking there must check, or
+            // before a marked successor, which is left for a later search to unlink.
+            void FindLastOfPriority(const K& priority, uint32_t levels, Path& predecessors, Path& successors,
+                                    bool hinted = false, bool exact = false)
             {
                 bool marked = false;
                 bool snip = false;
@@ -54,20 +317,71 @@ namespace CSLPQ
                 {
                     retry = false;
                     predecessor = this->head;
-                    for (int64_t level = L; level >= 0; --level)
+                    int64_t height = std::max(this->height.load(), levels);
+                    int64_t top = height - 1;
+                    if (hinted && !predecessors[top])
+                    {
+                        hinted = false;
+                    }
+                    if (!hinted)
+                    {
+                        for (int64_t level = top + 1; level <= L; ++level)
+                        {
+                            predecessors[level] = SPtr();
+                            successors[level] = SPtr();
+                        }
+                    }
+                    else
                     {
+                        for (; top >= 0; --top)
+                        {
+                            if (successors[top] && Less(successors[top]->GetPriority(), priority))
+                            {
+                                break;
+                            }
+                        }
+                        if (top >= 0)
+                        {
+                            predecessor = predecessors[top];
+                            if (predecessor != this->head && predecessor->IsNextMarked(top))
+                            {
+                                predecessor = this->head;
+                                top = height - 1;
+                            }
+                        }
+                    }
+                    for (int64_t level = top; level >= 0; --level)
+                    {
+                        const SPtr& hint = predecessors[level];
+                        if (hinted && hint != this->head && Less(hint->GetPriority(), priority) &&
+                            !hint->IsNextMarked(level) &&
+                            (predecessor == this->head || Less(predecessor->GetPriority(), hint->GetPriority())))
+                        {
+                            predecessor = hint;
+                        }
                         current = predecessor->GetNextPointer(level);
+                        uint64_t steps = 0;
                         while (current)
                         {
+                            // Marked or not, current is left to the next search
+                            if (!exact && StopsBefore(predecessor, level, priority))
+                            {
+                                break;
+                            }
                             std::tie(successor, marked) = current->GetNextPointerAndMark(level);
                             while (marked)
                             {
+                                // Unlink the whole run of marked nodes with a single CAS
+                                successor = this->SkipMarked(successor, level);
                                 snip = predecessor->CompareExchange(level, current, successor);
                                 if (!snip)
                                 {
+                                    this->statistics.Count(Event::SearchRetry);
                                     retry = true;
                                     break;
                                 }
+                                this->statistics.Count(Event::Snip);
+                                this->ReleaseRun(current, successor, level);
                                 current = successor;
                                 if (!current)
                                 {
@@ -86,10 +400,11 @@ namespace CSLPQ
                             {
                                 break;
                             }
-                            if (current->GetPriority() < priority)
+                            if (Less(current->GetPriority(), priority))
                             {
                                 predecessor = current;
                                 current = successor;
+                                ++steps;
                             }
                             else
                             {
@@ -100,6 +415,7 @@ namespace CSLPQ
                         {
                             break;
                         }
+                        this->statistics.Traversed(level, steps);
                         predecessors[level] = predecessor;
                         successors[level] = current;
                     }
@@ -107,6 +423,8 @@ namespace CSLPQ
                     {
                         break;
                     }
+                    // Hints may be overwritten by now, search from the head
+                    hinted = false;
                 }
             }
 
@@ -118,14 +436,14 @@ namespace CSLPQ
                 SPtr predecessor;
                 SPtr current;
                 SPtr successor;
-                SPtr empty;
 
                 bool retry;
                 while (true)
                 {
                     retry = false;
                     predecessor = this->head;
-                    for (int64_t level = L; level >= 0; --level)
+                    uint32_t height = this->height.load();
+                    for (int64_t level = height - 1; level >= 0; --level)
                     {
                         current = predecessor->GetNextPointer(level);
                         if (current)
@@ -133,12 +451,17 @@ namespace CSLPQ
                             std::tie(successor, marked) = current->GetNextPointerAndMark(level);
                             while (marked)
                             {
+                                // Unlink the whole run of marked nodes with a single CAS
+                                successor = this->SkipMarked(successor, level);
                                 snip = predecessor->CompareExchange(level, current, successor);
                                 if (!snip)
                                 {
+                                    this->statistics.Count(Event::FirstRetry);
                                     retry = true;
                                     break;
                                 }
+                                this->statistics.Count(Event::Snip);
+                                this->ReleaseRun(current, successor, level);
                                 current = successor;
                                 if (!current)
                                 {
@@ -160,414 +483,605 @@ namespace CSLPQ
                         }
                         else if (level == 0)
                         {
-                            return empty;
+                            return SPtr();
+                        }
+                        else if (level == height - 1)
+                        {
+                            this->LowerHeight(height);
                         }
                     }
                 }
             }
 
-        public:
-            explicit Queue(uint32_t max_size = 0) : max_size(max_size), head(new Node<K, L + 1>(K(), L + 1)), size(0)
-            {
-            }
-
-            Queue(const Queue&) = delete;
-
-            Queue(Queue&& other) noexcept : max_size(other.max_size), head(other.head),
-                  size(other.size)
+            // The first node pops start from. With eager deletion the marked prefix is unlinked first, with lazy
+            // deletion it is walked over and only unlinked once it grew to the threshold. Either way no node before the
+            // one returned is live.
+            SPtr Front()
             {
-                other.head = nullptr;
+                if (!Deletion::threshold)
+                {
+                    return this->FindFirst();
+                }
+                bool marked = false;
+                SPtr successor;
+                SPtr node = this->head->GetNextPointer(0);
+                for (uint32_t skipped = 0; node; ++skipped)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (!marked)
+                    {
+                        break;
+                    }
+                    if (skipped + 1 >= Deletion::threshold)
+                    {
+                        return this->FindFirst();
+                    }
+                    node = successor;
+                }
+                return node;
             }
 
-            Queue& operator=(const Queue&) = delete;
-
-            Queue& operator=(Queue&& other) noexcept
+            // The last node of the bottom level with a key smaller than priority, or the head, found from the top
+            // level down like a search but only reading. Nothing is unlinked. Above the bottom level the walk stops
+            // before popped nodes: one unlinked from the bottom level by a relaxed pop or a search stopping early may
+            // still be linked above, while its bottom link points at nodes already freed. At the bottom level they are
+            // walked over, every node there was reached from a live one under the guard of the caller.
+            SPtr Before(const K& priority) const
             {
-                this->max_size = other.max_size;
-                this->head = other.head;
-                this->size = other.size;
-                other.head = nullptr;
-                return *this;
+                SPtr predecessor = this->head;
+                for (int64_t level = this->height.load() - 1; level >= 0; --level)
+                {
+                    SPtr current = predecessor->GetNextPointer(level);
+                    while (current && !StopsBefore(predecessor, level, priority) &&
+                           Less(current->GetPriority(), priority) && (!level || !current->IsNextMarked(0)))
+                    {
+                        predecessor = current;
+                        current = current->GetNextPointer(level);
+                    }
+                }
+                return predecessor;
             }
 
-            void Push(const K& priority)
+            // A key no smaller than the last node of every level of the new node, or no larger than the first node of
+            // each, is linked there without a search. Only the levels of the new node are looked at, and a path that
+            // changed since fails the CAS of the bottom level like a stale hint does. Returns true once the bottom
+            // level is linked, false leaves the rest to a full search.
+            bool LinkAtEnd(const SPtr& new_node, Path& predecessors, Path& successors)
             {
-                this->Wait();
-                uint32_t new_level = this->GenerateRandomLevel();
-                SPtr new_node(new Node<K, L + 1>(priority, new_level));
-                std::vector<SPtr> predecessors(L + 1);
-                std::vector<SPtr> successors(L + 1);
-
-                while (true)
+                const K priority = new_node->GetPriority();
+                uint32_t new_level = new_node->GetLevel();
+                SPtr tail = this->tails[0].load();
+                if (tail && !Less(priority, tail->GetPriority()))
                 {
-                    this->FindLastOfPriority(priority, predecessors, successors);
                     for (uint32_t level = 0; level < new_level; ++level)
                     {
-                        new_node->SetNext(level, successors[level]);
+                        SPtr last = level ? this->tails[level].load() : tail;
+                        if (!last || Less(priority, last->GetPriority()) || last->GetNextPointer(level))
+                        {
+                            return false;
+                        }
+                        predecessors[level] = last;
+                        successors[level] = SPtr();
                     }
-                    if (!predecessors[0]->CompareExchange(0, successors[0], new_node))
+                }
+                else
+                {
+                    for (uint32_t level = 0; level < new_level; ++level)
                     {
-                        continue;
+                        SPtr first = this->head->GetNextPointer(level);
+                        if (first && Less(first->GetPriority(), priority))
+                        {
+                            return false;
+                        }
+                        predecessors[level] = this->head;
+                        successors[level] = first;
                     }
-                    for (uint32_t level = 1; level < new_level; ++level)
+                }
+                for (uint32_t level = 0; level < new_level; ++level)
+                {
+                    new_node->SetNext(level, successors[level]);
+                }
+                // Levels above are not searched, the path must not serve as a hint there
+                for (uint32_t level = new_level; level <= L; ++level)
+                {
+                    predecessors[level] = SPtr();
+                    successors[level] = SPtr();
+                }
+                return predecessors[0]->CompareExchange(0, successors[0], new_node);
+            }
+
+            // Links a new node at all of its levels. The path is left pointing at the node, so it can serve as the hint
+            // for a following priority no smaller than this one.
+            void Link(const SPtr& new_node, Path& predecessors, Path& successors, bool hinted)
+            {
+                const K priority = new_node->GetPriority();
+                uint32_t new_level = new_node->GetLevel();
+                this->RaiseHeight(new_level);
+                if (hinted || !this->LinkAtEnd(new_node, predecessors, successors))
+                {
+                    while (true)
                     {
-                        while (true)
+                        this->FindLastOfPriority(priority, new_level, predecessors, successors, hinted);
+                        // The kept part of a hinted path may be what fails the CAS, retries search properly
+                        hinted = false;
+                        for (uint32_t level = 0; level < new_level; ++level)
                         {
-                            if (predecessors[level]->CompareExchange(level, successors[level], new_node))
-                            {
-                                break;
-                            }
-                            this->FindLastOfPriority(priority, predecessors, successors);
+                            new_node->SetNext(level, successors[level]);
+                        }
+                        if (predecessors[0]->CompareExchange(0, successors[0], new_node))
+                        {
+                            break;
+                        }
+                        this->statistics.Count(Event::LinkRetry);
+                    }
+                }
+                for (uint32_t level = 1; level < new_level; ++level)
+                {
+                    while (true)
+                    {
+                        // A search that stopped on a lagging copy of a key may end short of the place at this level
+                        if (successors[level] && Less(successors[level]->GetPriority(), priority))
+                        {
+                            this->FindLastOfPriority(priority, new_level, predecessors, successors, false, true);
+                            continue;
+                        }
+                        // A failed CAS searches again, which may change successors of every level above this one
+                        new_node->SetNext(level, successors[level]);
+                        if (predecessors[level]->CompareExchange(level, successors[level], new_node))
+                        {
+                            break;
                         }
+                        this->statistics.Count(Event::LevelRetry);
+                        this->FindLastOfPriority(priority, new_level, predecessors, successors);
                     }
-                    break;
                 }
+                // The height may have been lowered while the node was linked above it
+                this->RaiseHeight(new_level);
                 new_node->SetDoneInserting();
-                this->size++;
+                for (uint32_t level = 0; level < new_level; ++level)
+                {
+                    if (!successors[level])
+                    {
+                        Reclamation::template Publish<Allocator>(this->tails[level], new_node);
+                    }
+                    predecessors[level] = new_node;
+                }
             }
 
-            bool TryPop(K& priority)
+            // Inserts keys sorted in queue order, every search starting from the path of the previous key. Unsorted keys
+            // are still inserted where they belong, only with longer searches. Bounded queues insert one key at a time,
+            // waiting for room must not happen inside the guard.
+            void PushSorted(const std::vector<K>& priorities)
             {
-                SPtr successor;
-                SPtr first = this->FindFirst();
-
-                if (!first)
-                {
-                    return false;
-                }
-                if (first->IsInserting())
+                if (this->max_size)
                 {
-                    return false;
+                    for (const K& priority : priorities)
+                    {
+                        this->Push(priority);
+                    }
+                    return;
                 }
 
-                for (uint32_t level = first->GetLevel() - 1; level >= 1; --level)
+                Guard guard;
+                Path predecessors;
+                Path successors;
+                bool hinted = false;
+                for (size_t i = 0; i < priorities.size(); ++i)
                 {
-                    first->SetNextMark(level);
+                    if (this->PushTie(priorities[i], predecessors, successors, hinted, priorities[i]))
+                    {
+                        continue;
+                    }
+                    uint32_t new_level = this->GenerateRandomLevel();
+                    SPtr new_node = this->MakeNode(priorities[i], new_level);
+                    this->Link(new_node, predecessors, successors, hinted);
+                    this->Pushed();
+                    hinted = true;
                 }
+            }
 
-                successor = first->GetNextPointer(0);
-                priority = first->GetPriority();
-                bool success = first->TestAndSetMark(0, successor);
-                if (success)
+            // Takes every node still holding an element out of a queue no other thread uses, in order, and leaves the
+            // queue empty. Popped nodes are freed. The nodes taken keep one link per level for their next queue.
+            // Returns how many elements they hold, ties included.
+            size_t Detach(std::vector<SPtr>& nodes)
+            {
+                size_t count = 0;
+                bool marked = false;
+                SPtr successor;
+                for (SPtr node = this->head->GetNextPointer(0); node; node = successor)
                 {
-                    this->size--;
-                    return true;
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (marked)
+                    {
+                        continue;
+                    }
+                    for (int slot = node->NextTie(0); slot >= 0; slot = node->NextTie(slot + 1))
+                    {
+                        ++count;
+                    }
+                    ++count;
+                    nodes.push_back(node);
                 }
-                else
+                for (const SPtr& node : nodes)
                 {
-                    return false;
+                    for (int level = 0; level < node->GetLevel(); ++level)
+                    {
+                        Reclamation::template Hold<Allocator>(node);
+                    }
                 }
+                this->DropTails();
+                Reclamation::template Destroy<Allocator>(this->head, L + 1);
+                this->head = MakeNode(K(), L + 1);
+                this->size.Set(0);
+                this->height = 1;
+                return count;
             }
 
-            uint32_t GetSize() const
+            // Links a node taken from another queue by Detach, counting the elements it holds
+            void Relink(const SPtr& node, Path& predecessors, Path& successors, bool hinted)
             {
-                return this->size.load();
+                node->SetInserting();
+                this->Link(node, predecessors, successors, hinted);
+                for (int slot = node->NextTie(0); slot >= 0; slot = node->NextTie(slot + 1))
+                {
+                    this->Pushed();
+                }
+                this->Pushed();
             }
 
-            std::string ToString(bool all_levels = false)
+            // Links the sorted elements that next(record) points record at, one at a time until it returns false, after
+            // the last node of each level in a single pass without searching or CAS. Only for a queue no other thread
+            // uses. Returns false without linking anything if the queue is not empty, and stops and returns false at
+            // the first key smaller than the one before it, keeping what was linked so far.
+            template <typename F>
+            bool Build(F next)
             {
-                static_assert(is_printable<K>::value, "Key type must be printable");
-                std::stringstream ss;
-                uint32_t max = all_levels? L : 0;
-                for (uint32_t level = 0; level <= max; ++level)
+                Guard guard;
+                if (this->FindFirst())
                 {
-                    if (all_levels)
+                    return false;
+                }
+                Path last;
+                last.fill(this->head);
+                uint32_t height = 1;
+                int64_t count = 0;
+                bool sorted = true;
+                const char* record = nullptr;
+                while (next(record))
+                {
+                    K priority;
+                    std::memcpy(static_cast<void*>(&priority), record, sizeof(K));
+                    if (count && Less(priority, last[0]->GetPriority()))
                     {
-                        ss << "Queue at level " << level << ":\n";
+                        sorted = false;
+                        break;
                     }
-                    else
+                    uint32_t level = this->GenerateRandomLevel();
+                    SPtr node = this->MakeNode(priority, level);
+                    node->SetDoneInserting();
+                    for (uint32_t i = 0; i < level; ++i)
                     {
-                        ss << "Queue: \n";
+                        last[i]->SetNext(i, node);
+                        last[i] = node;
                     }
-
-                    bool marked = false;
-                    SPtr node;
-                    SPtr nnode;
-                    std::tie(node, marked) = this->head->GetNextPointerAndMark(level);
-                    while (node)
+                    height = std::max(height, level);
+                    ++count;
+                }
+                this->RaiseHeight(height);
+                for (int level = 0; level <= L; ++level)
+                {
+                    if (last[level] != this->head)
                     {
-                        std::tie(nnode, marked) = node->GetNextPointerAndMark(level);
-                        if (!marked)
-                        {
-                            ss << "\tKey: " << node->GetPriority() << "\n";
-                        }
-                        else
-                        {
-                            ss << "\tKey: " << node->GetPriority() << " (Marked)\n";
-                        }
-                        node = nnode;
+                        Reclamation::template Publish<Allocator>(this->tails[level], last[level]);
                     }
                 }
-                return ss.str();
+                this->size.Add(count);
+                return sorted;
             }
-    };
-
-    template<typename K, typename V, int L = 4>
-    class KVQueue
-    {
-        static_assert(is_comparable<K>::value, "Key type must be totally ordered");
-        static_assert(std::is_move_constructible<V>::value || std::is_copy_constructible<V>::value ||
-                      std::is_default_constructible<V>::value || std::is_fundamental<V>::value, 
-                      "Value type must be fundamental, or default constructible, or copy or move constructible");
-        private:
-            typedef jss::shared_ptr<KVNode<K, V, L + 1>> SPtr;
 
-            const uint32_t max_size;
-            SPtr head;
-            std::atomic<uint32_t> size;
+            static CheckpointHeader Header()
+            {
+                static_assert(std::is_trivially_copyable<K>::value, "Key type must be trivially copyable to checkpoint");
+                return CheckpointHeader::For(sizeof(K), 0);
+            }
 
-            void Wait()
+            // Passes the header and then every key in order to write(bytes, size), returns how many keys there were
+            template <typename F>
+            size_t Write(F write) const
             {
-                if (this->max_size)
+                CheckpointHeader header = Header();
+                write(reinterpret_cast<const char*>(&header), sizeof(header));
+                size_t count = 0;
+                for (Iterator it = this->begin(); it.node; ++it)
                 {
-                    while (this->size >= this->max_size);
+                    write(reinterpret_cast<const char*>(&*it), sizeof(K));
+                    ++count;
                 }
+                return count;
             }
 
-            uint32_t GenerateRandomLevel()
+            void DropTails()
             {
-                static std::random_device rd;
-                static std::mt19937 mt(rd());
-                static std::uniform_int_distribution<uint32_t> dist(1, L + 1);
-
-                return dist(mt);
+                for (int level = 0; level <= L; ++level)
+                {
+                    Reclamation::template Drop<Allocator>(this->tails[level]);
+                }
             }
 
-            void FindLastOfPriority(const K& priority, std::vector<SPtr>& predecessors,
-                                    std::vector<SPtr>& successors)
+        public:
+            // Pops come out in this order, the smallest first under it
+            typedef typename T::Compare Compare;
+
+            // Refers to an element pushed with PushWithHandle, for Erase and UpdatePriority on the same queue. The node
+            // stays allocated while a handle to it lives, even once the element left the queue.
+            class Handle
             {
-                bool marked = false;
-                bool snip = false;
+                friend class Queue;
+                private:
+                    SPtr node;
 
-                SPtr predecessor;
-                SPtr current;
-                SPtr successor;
+                    explicit Handle(const SPtr& node) : node(node)
+                    {
+                        Reclamation::template Hold<Allocator>(this->node);
+                    }
 
-                bool retry;
-                while (true)
-                {
-                    retry = false;
-                    predecessor = this->head;
-                    for (int64_t level = L; level >= 0; --level)
+                public:
+                    Handle() : node()
                     {
-                        current = predecessor->GetNextPointer(level);
-                        while (current)
+                    }
+
+                    Handle(const Handle& other) : node(other.node)
+                    {
+                        if (this->node)
                         {
-                            std::tie(successor, marked) = current->GetNextPointerAndMark(level);
-                            while (marked)
-                            {
-                                snip = predecessor->CompareExchange(level, current, successor);
-                                if (!snip)
-                                {
-                                    retry = true;
-                                    break;
-                                }
-                                current = successor;
-                                if (!current)
-                                {
-                                    marked = false;
-                                }
-                                else
-                                {
-                                    std::tie(successor, marked) = current->GetNextPointerAndMark(level);
-                                }
-                            }
-                            if (retry)
-                            {
-                                break;
-                            }
-                            if (!current)
-                            {
-                                break;
-                            }
-                            if (current->GetPriority() < priority)
-                            {
-                                predecessor = current;
-                                current = successor;
-                            }
-                            else
-                            {
-                                break;
-                            }
+                            Reclamation::template Hold<Allocator>(this->node);
                         }
-                        if (retry)
+                    }
+
+                    Handle(Handle&& other) noexcept : node(other.node)
+                    {
+                        other.node = SPtr();
+                    }
+
+                    Handle& operator=(Handle other) noexcept
+                    {
+                        std::swap(this->node, other.node);
+                        return *this;
+                    }
+
+                    ~Handle()
+                    {
+                        if (this->node)
                         {
-                            break;
+                            Reclamation::template Unlinked<Allocator>(this->node);
                         }
-                        predecessors[level] = predecessor;
-                        successors[level] = current;
                     }
-                    if (!retry)
+
+                    bool IsValid() const
                     {
-                        break;
+                        return static_cast<bool>(this->node);
                     }
-                }
-            }
+            };
 
-            SPtr FindFirst()
+            // A forward iterator over the keys in the queue from the smallest on, ties included. It only reads, so it is
+            // weakly consistent: keys popped after it passed them are still seen, keys pushed behind it may or may not
+            // be, and popped or half inserted nodes are skipped as it reaches them. It holds the guard of the queue, so
+            // with EpochReclamation no node is freed while an iterator lives and it must stay on the thread that made
+            // it.
+            class Iterator
             {
-                bool marked = false;
-                bool snip = false;
+                friend class Queue;
+                private:
+                    Guard guard;
+                    SPtr node;
+                    int slot;
+                    K priority;
 
-                SPtr predecessor;
-                SPtr current;
-                SPtr successor;
-                SPtr empty;
+                    explicit Iterator(const SPtr& node) : guard(), node(node), slot(-1), priority()
+                    {
+                        this->Seek();
+                    }
 
-                bool retry;
-                while (true)
-                {
-                    retry = false;
-                    predecessor = this->head;
-                    for (int64_t level = L; level >= 0; --level)
+                    // From node on, stops at the first node neither popped nor being inserted
+                    void Seek()
                     {
-                        current = predecessor->GetNextPointer(level);
-                        if (current)
+                        while (this->node && (this->node->IsNextMarked(0) || this->node->IsInserting()))
                         {
-                            std::tie(successor, marked) = current->GetNextPointerAndMark(level);
-                            while (marked)
-                            {
-                                snip = predecessor->CompareExchange(level, current, successor);
-                                if (!snip)
-                                {
-                                    retry = true;
-                                    break;
-                                }
-                                current = successor;
-                                if (!current)
-                                {
-                                    marked = false;
-                                }
-                                else
-                                {
-                                    std::tie(successor, marked) = current->GetNextPointerAndMark(level);
-                                }
-                            }
-                            if (retry)
-                            {
-                                break;
-                            }
-                            if (level == 0)
-                            {
-                                return current;
-                            }
+                            this->node = this->node->GetNextPointer(0);
                         }
-                        else if (level == 0)
+                        if (this->node)
+                        {
+                            this->slot = this->node->NextTie(0);
+                            this->priority = this->node->GetPriority(this->slot);
+                        }
+                        else
                         {
-                            return empty;
+                            this->slot = -1;
                         }
                     }
-                }
+
+                public:
+                    typedef std::forward_iterator_tag iterator_category;
+                    typedef K value_type;
+                    typedef std::ptrdiff_t difference_type;
+                    typedef const K* pointer;
+                    typedef const K& reference;
+
+                    Iterator() : guard(), node(), slot(-1), priority()
+                    {
+                    }
+
+                    reference operator*() const
+                    {
+                        return this->priority;
+                    }
+
+                    pointer operator->() const
+                    {
+                        return &this->priority;
+                    }
+
+                    // Ties of a node come before its own element, the order pops take them in
+                    Iterator& operator++()
+                    {
+                        if (this->slot >= 0)
+                        {
+                            this->slot = this->node->NextTie(this->slot + 1);
+                            if (this->slot >= 0 || !this->node->IsNextMarked(0))
+                            {
+                                this->priority = this->node->GetPriority(this->slot);
+                                return *this;
+                            }
+                        }
+                        this->node = this->node->GetNextPointer(0);
+                        this->Seek();
+                        return *this;
+                    }
+
+                    Iterator operator++(int)
+                    {
+                        Iterator old(*this);
+                        ++*this;
+                        return old;
+                    }
+
+                    bool operator==(const Iterator& other) const
+                    {
+                        return this->node == other.node && this->slot == other.slot;
+                    }
+
+                    bool operator!=(const Iterator& other) const
+                    {
+                        return !(*this == other);
+                    }
+            };
+
+            typedef Iterator iterator;
+            typedef Iterator const_iterator;
+
+            explicit Queue(uint64_t max_size = 0) : max_size(max_size),
+                    head(MakeNode(K(), L + 1)), size(), height(1)
+            {
             }
 
-        public:
-            KVQueue(uint32_t max_size = 0) : max_size(max_size), head(new KVNode<K, V, L + 1>(K(), L + 1)), size(0)
+            ~Queue()
             {
+                this->DropTails();
+                Reclamation::template Destroy<Allocator>(this->head, L + 1);
             }
 
-            KVQueue(const KVQueue&) = delete;
+            Queue(const Queue&) = delete;
 
-            KVQueue(KVQueue&& other)  noexcept : max_size(other.max_size), head(other.head),
-                    size(other.size)
+            Queue(Queue&& other) noexcept : max_size(other.max_size), head(other.head),
+                  size(), height(other.height.load())
             {
+                this->size.Set(other.size.Get());
+                other.DropTails();
                 other.head = nullptr;
-                other.size = 0;
             }
 
-            KVQueue& operator=(const KVQueue&) = delete;
+            Queue& operator=(const Queue&) = delete;
 
-            KVQueue& operator=(KVQueue&& other) noexcept
+            Queue& operator=(Queue&& other) noexcept
             {
+                this->DropTails();
+                other.DropTails();
+                Reclamation::template Destroy<Allocator>(this->head, L + 1);
                 this->max_size = other.max_size;
                 this->head = other.head;
-                this->size = other.size;
+                this->size.Set(other.size.Get());
+                this->height = other.height.load();
                 other.head = nullptr;
-                other.size = 0;
                 return *this;
             }
 
             void Push(const K& priority)
             {
                 this->Wait();
-                uint32_t new_level = this->GenerateRandomLevel();
-                SPtr new_node(new KVNode<K, V, L + 1>(priority, new_level));
-                std::vector<SPtr> predecessors(L + 1);
-                std::vector<SPtr> successors(L + 1);
-
-                while (true)
+                Guard guard;
+                Path predecessors;
+                Path successors;
+                bool hinted = false;
+                if (this->PushTie(priority, predecessors, successors, hinted, priority))
                 {
-                    this->FindLastOfPriority(priority, predecessors, successors);
-                    for (uint32_t level = 0; level < new_level; ++level)
-                    {
-                        new_node->SetNext(level, successors[level]);
-                    }
-                    if (!predecessors[0]->CompareExchange(0, successors[0], new_node))
-                    {
-                        continue;
-                    }
-                    for (uint32_t level = 1; level < new_level; ++level)
-                    {
-                        while (true)
-                        {
-                            if (predecessors[level]->CompareExchange(level, successors[level], new_node))
-                            {
-                                break;
-                            }
-                            this->FindLastOfPriority(priority, predecessors, successors);
-                        }
-                    }
-                    break;
+                    return;
                 }
-                new_node->SetDoneInserting();
-                this->size++;
+                uint32_t new_level = this->GenerateRandomLevel();
+                SPtr new_node = this->MakeNode(priority, new_level);
+                this->Link(new_node, predecessors, successors, hinted);
+                this->Pushed();
             }
 
-            void Push(const K& priority, const V& data)
+            // Inserts the keys of a range. The batch is sorted first and every search starts from the path of the
+            // previous key, so the whole batch costs about one pass over the list instead of a search from the head per
+            // key. Bounded queues insert one key at a time, waiting for room must not happen inside the guard.
+            template <typename It>
+            void PushBulk(It first, It last)
+            {
+                std::vector<K> priorities(first, last);
+                std::sort(priorities.begin(), priorities.end(), Compare());
+                this->PushSorted(priorities);
+            }
+
+            // Like Push, but returns a handle to the element. It always gets a node of its own, even with tie buckets.
+            Handle PushWithHandle(const K& priority)
             {
                 this->Wait();
-                uint32_t new_level = this->GenerateRandomLevel();
-                SPtr new_node(new KVNode<K, V, L + 1>(priority, data, new_level));
-                std::vector<SPtr> predecessors(L + 1);
-                std::vector<SPtr> successors(L + 1);
+                Guard guard;
+                Path predecessors;
+                Path successors;
+                SPtr new_node = this->MakeNode(priority, this->GenerateRandomLevel());
+                new_node->CloseTies();
+                // Held before linking, a pop may free the node as soon as it is linked
+                Handle handle(new_node);
+                this->Link(new_node, predecessors, successors, false);
+                this->Pushed();
+                return handle;
+            }
 
-                while (true)
+            // Removes the element of the handle, fails if it was popped or erased already
+            bool Erase(const Handle& handle)
+            {
+                Guard guard;
+                return this->Remove(handle.node);
+            }
+
+            // Erases the element of the handle and pushes it again with a new key, after which the handle refers to the
+            // new element. Fails if the element was popped or erased already. Other threads may miss the element while
+            // it moves.
+            bool UpdatePriority(Handle& handle, const K& priority)
+            {
+                if (!this->Erase(handle))
                 {
-                    this->FindLastOfPriority(priority, predecessors, successors);
-                    for (uint32_t level = 0; level < new_level; ++level)
-                    {
-                        new_node->SetNext(level, successors[level]);
-                    }
-                    if (!predecessors[0]->CompareExchange(0, successors[0], new_node))
-                    {
-                        continue;
-                    }
-                    for (uint32_t level = 1; level < new_level; ++level)
-                    {
-                        while (true)
-                        {
-                            if (predecessors[level]->CompareExchange(level, successors[level], new_node))
-                            {
-                                break;
-                            }
-                            this->FindLastOfPriority(priority, predecessors, successors);
-                        }
-                    }
-                    break;
+                    return false;
                 }
-                new_node->SetDoneInserting();
-                this->size++;
+                handle = this->PushWithHandle(priority);
+                return true;
             }
 
-            bool TryPop(K& priority, V& data)
+            bool TryPop(K& priority)
             {
+                Guard guard;
                 SPtr successor;
-                SPtr first = this->FindFirst();
+                SPtr first = this->Front();
 
                 if (!first)
                 {
                     return false;
                 }
+                int slot = first->TryPopTie();
+                if (slot >= 0)
+                {
+                    priority = first->GetPriority(slot);
+                    this->Popped();
+                    return true;
+                }
                 if (first->IsInserting())
+                {
+                    this->statistics.Count(Event::Inserting);
+                    return false;
+                }
+                if (!first->CloseTies())
                 {
                     return false;
                 }
@@ -579,28 +1093,1867 @@ namespace CSLPQ
 
                 successor = first->GetNextPointer(0);
                 priority = first->GetPriority();
-                data = first->GetData();
                 bool success = first->TestAndSetMark(0, successor);
                 if (success)
                 {
-                    this->size--;
+                    this->Popped();
                     return true;
                 }
                 else
+                {
+                    this->statistics.Count(Event::LostMark);
+                    return false;
+                }
+            }
+
+            // Unlike TryPop, fails only if there is nothing to pop. A node still being inserted is skipped, its push
+            // has not returned yet, and a lost race moves on to the next node instead of giving up.
+            bool TryPopStrong(K& priority)
+            {
+                Guard guard;
+                int slot;
+                SPtr node = this->Claim(this->Front(), slot);
+                if (!node)
                 {
                     return false;
                 }
+                priority = node->GetPriority(slot);
+                return true;
             }
 
-            uint32_t GetSize() const
+            // Pops one of roughly the bound smallest elements instead of the smallest one, so that concurrent consumers
+            // spread over the front of the queue instead of all fighting over the first node. Fails only if there is
+            // nothing to pop, a bound of 1 behaves like TryPopStrong.
+            bool TryPopRelaxed(K& priority, uint32_t bound = 16)
             {
-                return this->size.load();
+                Guard guard;
+                int slot;
+                SPtr node = this->Claim(this->Spray(bound), slot);
+                if (!node)
+                {
+                    // Nothing left from the landing node on, look from the front
+                    return this->TryPopStrong(priority);
+                }
+                priority = node->GetPriority(slot);
+                return true;
+            }
+
+            // Pops up to n of the smallest keys in a single walk over the bottom level, writing them to out. Claimed
+            // nodes are unlinked together afterwards, one CAS per level for the whole run, or with lazy deletion once
+            // the marked prefix reached the threshold. Returns how many keys were popped, nodes still being inserted are
+            // skipped like in TryPopStrong.
+            template <typename OutputIt>
+            size_t TryPopN(OutputIt out, size_t n)
+            {
+                Guard guard;
+                size_t count = 0;
+                SPtr node = n ? this->Front() : SPtr();
+                int slot;
+
+                while (count < n && (node = this->Claim(node, slot)))
+                {
+                    *out = node->GetPriority(slot);
+                    ++out;
+                    ++count;
+                    // Marked links no longer change, this is the successor the mark was set on. A popped tie leaves
+                    // the node in place.
+                    if (slot < 0)
+                    {
+                        node = node->GetNextPointer(0);
+                    }
+                }
+                if (count)
+                {
+                    this->Front();
+                }
+                return count;
+            }
+
+            // Pops every key in order in a single walk, like TryPopN without a bound. Returns how many keys were popped.
+            template <typename OutputIt>
+            size_t DrainTo(OutputIt out)
+            {
+                return this->TryPopN(out, std::numeric_limits<size_t>::max());
+            }
+
+            // Moves up to max of the smallest keys of victim into this queue, at most half of what it holds rounded up,
+            // and returns how many moved. They leave victim in a single walk like TryPopN and are linked here in order
+            // like PushBulk, so a steal costs about one pass over each list instead of a pop and a push from the head
+            // per key. Both queues may be used by other threads meanwhile, which may find the keys in neither queue
+            // while they move.
+            size_t StealHalf(Queue& victim, size_t max = std::numeric_limits<size_t>::max())
+            {
+                if (&victim == this)
+                {
+                    return 0;
+                }
+                int64_t count = victim.Count();
+                size_t n = std::min(max, count > 0 ? static_cast<size_t>(count + 1) / 2 : 0);
+                std::vector<K> stolen;
+                stolen.reserve(n);
+                victim.TryPopN(std::back_inserter(stolen), n);
+                this->PushSorted(stolen);
+                return stolen.size();
+            }
+
+            // Moves every key of other into this queue and returns how many moved. other is given up, no other
+            // thread may use it while it is merged, and it is left empty. The keys move with their nodes, popped
+            // nodes are freed and the rest are linked here in order, every search starting from the path of the
+            // previous node. A merge costs about one pass over each list and allocates no nodes. Other threads may use
+            // this queue meanwhile. Handles to keys of other refer to them in this queue afterwards.
+            size_t Merge(Queue&& other)
+            {
+                if (&other == this)
+                {
+                    return 0;
+                }
+                std::vector<SPtr> nodes;
+                size_t count = other.Detach(nodes);
+                Path predecessors;
+                Path successors;
+                if (!this->max_size)
+                {
+                    Guard guard;
+                    bool hinted = false;
+                    for (const SPtr& node : nodes)
+                    {
+                        this->Relink(node, predecessors, successors, hinted);
+                        hinted = true;
+                    }
+                    return count;
+                }
+                // Waiting for room must not happen inside the guard
+                for (const SPtr& node : nodes)
+                {
+                    this->Wait();
+                    Guard guard;
+                    this->Relink(node, predecessors, successors, false);
+                }
+                return count;
+            }
+
+            // Removes every element in a single walk and returns how many there were. Elements are marked like pops,
+            // then the whole marked prefix is unlinked with one CAS per level. With SharedReclamation the nodes are
+            // freed by this call, with EpochReclamation they are retired and freed by later collections. Elements
+            // whose push has not returned yet stay in the queue.
+            size_t Clear()
+            {
+                Guard guard;
+                size_t count = 0;
+                SPtr node = this->Front();
+                int slot;
+
+                while ((node = this->Claim(node, slot)))
+                {
+                    ++count;
+                    if (slot < 0)
+                    {
+                        node = node->GetNextPointer(0);
+                    }
+                }
+                if (count)
+                {
+                    this->FindFirst();
+                }
+                return count;
+            }
+
+            // Reads the smallest key without popping it, fails only if there is nothing to pop. Someone else may pop it
+            // right after. With EpochReclamation the walk is plain loads, no reference counts are taken.
+            bool TryPeek(K& priority)
+            {
+                Guard guard;
+                bool marked = false;
+                SPtr successor;
+                SPtr node = this->Front();
+                while (node)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (!marked && !node->IsInserting())
+                    {
+                        priority = node->GetPriority();
+                        return true;
+                    }
+                    node = successor;
+                }
+                return false;
+            }
+
+            // Blocks until an element could be popped, spinning for a while before parking the thread
+            void Pop(K& priority)
+            {
+                while (!this->TryPopStrong(priority))
+                {
+                    this->not_empty.Wait([this]() { return this->Count() > 0; });
+                }
+            }
+
+            // Like Pop, but gives up once the timeout passed
+            template <typename Rep, typename Period>
+            bool TryPopFor(K& priority, const std::chrono::duration<Rep, Period>& timeout)
+            {
+                auto deadline = std::chrono::steady_clock::now() + timeout;
+                while (!this->TryPopStrong(priority))
+                {
+                    if (!this->not_empty.WaitUntil([this]() { return this->Count() > 0; }, deadline))
+                    {
+                        return this->TryPopStrong(priority);
+                    }
+                }
+                return true;
+            }
+
+            // Approximate while other threads push and pop, and with a striped counter a sum over its stripes
+            uint64_t GetSize() const
+            {
+                int64_t count = this->Count();
+                return count > 0 ? static_cast<uint64_t>(count) : 0;
+            }
+
+            // Contention events and search steps per level counted so far, all zero unless the traits enable
+            // statistics
+            QueueStats GetStats() const
+            {
+                return this->statistics.Get();
+            }
+
+            // From the smallest key on, see Iterator
+            Iterator begin() const
+            {
+                // Pinned until the iterator pins on its own
+                Guard guard;
+                return Iterator(this->head->GetNextPointer(0));
+            }
+
+            Iterator end() const
+            {
+                return Iterator();
+            }
+
+            // Calls fn(key) on every key in [lo, hi) in order, ties included, and returns how many there were. The
+            // levels take the walk straight to the first key no smaller than lo, and nothing is unlinked on the way.
+            // Weakly consistent like Iterator.
+            template <typename F>
+            size_t ForEachInRange(const K& lo, const K& hi, F fn) const
+            {
+                Guard guard;
+                SPtr predecessor = this->Before(lo);
+                size_t count = 0;
+                for (Iterator it(predecessor->GetNextPointer(0)); it.node && Less(*it, hi); ++it)
+                {
+                    fn(*it);
+                    ++count;
+                }
+                return count;
+            }
+
+            // Writes every key in order to out as a checkpoint, a CheckpointHeader followed by the raw bytes of the
+            // keys, and returns how many were written. Weakly consistent like Iterator, so for a checkpoint of a
+            // moment in time no other thread should push or pop meanwhile.
+            size_t Serialize(std::ostream& out) const
+            {
+                return this->Write([&](const char* bytes, size_t size)
+                {
+                    out.write(bytes, size);
+                });
+            }
+
+            // Like Serialize to a stream, appending to buffer
+            size_t Serialize(std::vector<char>& buffer) const
+            {
+                return this->Write([&](const char* bytes, size_t size)
+                {
+                    buffer.insert(buffer.end(), bytes, bytes + size);
+                });
+            }
+
+            // Rebuilds the queue from a checkpoint in memory, such as a MappedFile, in O(n): nodes are linked bottom up
+            // in the order they are read, straight from data without copying the checkpoint. Only for an empty queue
+            // no other thread uses yet, and max_size is not enforced. Fails if the queue is not empty, the header does
+            // not match K, or the size is not a whole number of keys, all before restoring anything, or at the first
+            // key out of order, keeping the keys before it.
+            bool Restore(const void* data, size_t size)
+            {
+                CheckpointHeader header;
+                if (size < sizeof(header))
+                {
+                    return false;
+                }
+                std::memcpy(&header, data, sizeof(header));
+                if (!header.Matches(this->Header()) || (size - sizeof(header)) % header.RecordSize())
+                {
+                    return false;
+                }
+                const char* position = static_cast<const char*>(data) + sizeof(header);
+                const char* end = static_cast<const char*>(data) + size;
+                return this->Build([&](const char*& record) -> bool
+                {
+                    if (position == end)
+                    {
+                        return false;
+                    }
+                    record = position;
+                    position += header.RecordSize();
+                    return true;
+                });
+            }
+
+            bool Restore(const MappedFile& file)
+            {
+                return file.IsValid() && this->Restore(file.Data(), file.Size());
+            }
+
+            // Like Restore from memory, reading one key at a time from in. Also fails if the stream ends inside a key.
+            bool Restore(std::istream& in)
+            {
+                CheckpointHeader header;
+                if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || !header.Matches(this->Header()))
+                {
+                    return false;
+                }
+                char buffer[sizeof(K)];
+                bool truncated = false;
+                bool sorted = this->Build([&](const char*& record) -> bool
+                {
+                    in.read(buffer, sizeof(buffer));
+                    truncated = in.gcount() && in.gcount() != static_cast<std::streamsize>(sizeof(buffer));
+                    record = buffer;
+                    return in.gcount() == static_cast<std::streamsize>(sizeof(buffer));
+                });
+                return sorted && !truncated;
+            }
+
+            std::string ToString(bool all_levels = false)
+            {
+                static_assert(is_printable<K>::value, "Key type must be printable");
+                Guard guard;
+                std::stringstream ss;
+                uint32_t max = all_levels? L : 0;
+                for (uint32_t level = 0; level <= max; ++level)
+                {
+                    if (all_levels)
+                    {
+                        ss << "Queue at level " << level << ":\n";
+                    }
+                    else
+                    {
+                        ss << "Queue: \n";
+                    }
+
+                    bool marked = false;
+                    SPtr node;
+                    SPtr nnode;
+                    std::tie(node, marked) = this->head->GetNextPointerAndMark(level);
+                    while (node)
+                    {
+                        std::tie(nnode, marked) = node->GetNextPointerAndMark(level);
+                        if (!marked)
+                        {
+                            ss << "\tKey: " << node->GetPriority() << "\n";
+                        }
+                        else
+                        {
+                            ss << "\tKey: " << node->GetPriority() << " (Marked)\n";
+                        }
+                        node = nnode;
+                    }
+                }
+                return ss.str();
+            }
+    };
+
+    template<typename K, typename V, int L = 31, typename T = DefaultTraits<K>>
+    class KVQueue
+    {
+        static_assert(is_ordered_by<K, typename T::Compare>::value, "Key type must be totally ordered by Compare");
+        static_assert(std::is_move_constructible<V>::value || std::is_copy_constructible<V>::value ||
+                      std::is_default_constructible<V>::value || std::is_fundamental<V>::value, 
+                      "Value type must be fundamental, or default constructible, or copy or move constructible");
+        private:
+            typedef typename T::LevelGenerator LevelGenerator;
+            typedef typename T::Reclamation Reclamation;
+            typedef typename T::Allocator Allocator;
+            typedef typename T::Counter Counter;
+            typedef typename T::Deletion Deletion;
+            typedef typename T::Statistics::template Counters<L + 1> Statistics;
+            typedef typename T::Ties::template Bucket<std::pair<K, V>, Allocator> Bucket;
+            typedef KVNode<K, V, L + 1, Reclamation, Bucket> NodeType;
+            typedef typename NodeType::SPtr SPtr;
+            typedef typename NodeType::MASPtr MASPtr;
+            typedef typename Reclamation::Guard Guard;
+            typedef std::array<SPtr, L + 1> Path;
+
+            const uint64_t max_size;
+            SPtr head;
+            // A pop may be counted before the push of the same node, so the count can dip below zero
+            Counter size;
+            // Number of levels in use, searches start at its top instead of at L. Pushers raise it before linking a
+            // taller node, pops lower it when they find the top level empty. It is only a hint, a pusher always
+            // searches the levels of its own node.
+            std::atomic<uint32_t> height;
+            Parker not_empty;
+            Parker not_full;
+            Statistics statistics;
+            // The node last linked at the end of each level, so pushes of a new largest key skip the search
+            MASPtr tails[L + 1];
+
+            // Whether a key comes out before another, everything below reads as a min queue under this order
+            static bool Less(const K& a, const K& b)
+            {
+                return Compare()(a, b);
+            }
+
+            // Whether a search can stop at level before the successor of predecessor, on the copy of its key kept next
+            // to the link and without loading the successor. Never at the bottom level, where ties and pops need the
+            // exact successor.
+            static bool StopsBefore(const SPtr& predecessor, int64_t level, const K& priority)
+            {
+                return level && predecessor->TestNextPriority(level, [&](const K& next)
+                {
+                    return !Less(next, priority);
+                });
+            }
+
+            // Approximate with a striped counter, which is all the max_size bound needs
+            int64_t Count() const
+            {
+                return this->size.Get();
+            }
+
+            void Wait()
+            {
+                if (this->max_size)
+                {
+                    this->not_full.Wait([this]() { return this->Count() < static_cast<int64_t>(this->max_size); });
+                }
+            }
+
+            void Pushed()
+            {
+                this->size.Add(1);
+                this->not_empty.NotifyOne();
+            }
+
+            void Popped()
+            {
+                this->size.Add(-1);
+                if (this->max_size)
+                {
+                    this->not_full.NotifyOne();
+                }
+            }
+
+            uint32_t GenerateRandomLevel()
+            {
+                return LevelGenerator::Generate(L + 1);
+            }
+
+            void RaiseHeight(uint32_t level)
+            {
+                uint32_t current = this->height.load();
+                while (current < level && !this->height.compare_exchange_weak(current, level))
+                {
+                }
+            }
+
+            // Called after finding the top level empty. A push that linked there in the meantime is seen by the check
+            // after lowering, or raises the height again itself once it linked.
+            void LowerHeight(uint32_t height)
+            {
+                uint32_t expected = height;
+                if (this->height.compare_exchange_strong(expected, height - 1) &&
+                    this->head->GetNextPointer(height - 1))
+                {
+                    this->RaiseHeight(height);
+                }
+            }
+
+            // A node with exactly level links, the value is constructed in place from args
+            template <typename... Args>
+            static SPtr MakeNode(const K& priority, int level, Args&&... args)
+            {
+                return Reclamation::template Make<NodeType, Allocator>(NodeType::Size(level), priority, level,
+                                                                       std::forward<Args>(args)...);
+            }
+
+            // With tie buckets, pushes into the bucket of the first node of an equal key if there is one. Otherwise the
+            // search is left in the path, linking a new node can start from it as a hint. args construct the pair.
+            template <typename... Args>
+            bool PushTie(const K& priority, Path& predecessors, Path& successors, bool& hinted, Args&&... args)
+            {
+                if (!Bucket::enabled)
+                {
+                    return false;
+                }
+                this->FindLastOfPriority(priority, 1, predecessors, successors, hinted);
+                hinted = true;
+                const SPtr& successor = successors[0];
+                if (successor && !Less(priority, successor->GetPriority()) &&
+                    successor->TryPushTie(std::forward<Args>(args)...))
+                {
+                    this->Pushed();
+                    return true;
+                }
+                return false;
+            }
+
+            // The first node from node on that is not marked at this level
+            SPtr SkipMarked(SPtr node, int level)
+            {
+                bool marked = false;
+                SPtr next;
+                while (node)
+                {
+                    std::tie(next, marked) = node->GetNextPointerAndMark(level);
+                    if (!marked)
+                    {
+                        break;
+                    }
+                    node = next;
+                }
+                return node;
+            }
+
+            // Called once a CAS unlinked the nodes from first up to, not including, last at this level
+            void ReleaseRun(SPtr first, const SPtr& last, int level)
+            {
+                while (first != last)
+                {
+                    SPtr next = first->GetNextPointer(level);
+                    Reclamation::template Unlinked<Allocator>(first);
+                    first = next;
+                }
+            }
+
+            // Pops the first node from node on that is neither marked nor still being inserted, returns it or nothing if
+            // no such node is left. A lost race looks at the same node again: it was either popped by someone else or
+            // its successor changed under the mark. slot is set to the bucket slot of a popped tie, or -1 if the node
+            // itself was popped.
+            SPtr Claim(SPtr node, int& slot)
+            {
+                bool marked = false;
+                SPtr successor;
+                while (node)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (marked)
+                    {
+                        node = successor;
+                        continue;
+                    }
+                    // Ties go first, the node itself only once its bucket is closed and drained
+                    slot = node->TryPopTie();
+                    if (slot < 0 && !node->IsInserting() && !node->CloseTies())
+                    {
+                        slot = node->TryPopTie();
+                        if (slot < 0)
+                        {
+                            // The rest of the bucket is still being pushed
+                            node = successor;
+                            continue;
+                        }
+                    }
+                    if (slot >= 0)
+                    {
+                        this->Popped();
+                        return node;
+                    }
+                    if (node->IsInserting())
+                    {
+                        this->statistics.Count(Event::Inserting);
+                        node = successor;
+                        continue;
+                    }
+
+                    for (uint32_t level = node->GetLevel() - 1; level >= 1; --level)
+                    {
+                        node->SetNextMark(level);
+                    }
+                    if (node->TestAndSetMark(0, successor))
+                    {
+                        this->Popped();
+                        return node;
+                    }
+                    this->statistics.Count(Event::LostMark);
+                }
+                return SPtr();
+            }
+
+            // Marks a node all the way down like a pop, true if this call won the mark of level 0. Only for nodes of
+            // handles, which are fully linked and never hold ties.
+            bool Remove(const SPtr& node)
+            {
+                for (uint32_t level = node->GetLevel() - 1; level >= 1; --level)
+                {
+                    node->SetNextMark(level);
+                }
+                bool marked = false;
+                SPtr successor;
+                while (true)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (marked)
+                    {
+                        return false;
+                    }
+                    if (node->TestAndSetMark(0, successor))
+                    {
+                        break;
+                    }
+                }
+                this->Popped();
+                // Unlinks it right away if it is the first of its key, otherwise searches and pops passing it do. The
+                // search is exact, one stopping on a copy of its key would not load the node and unlink it.
+                Path predecessors;
+                Path successors;
+                this->FindLastOfPriority(node->GetPriority(), node->GetLevel(), predecessors, successors, false, true);
+                return true;
+            }
+
+            // Walks to a live node picked uniformly among the first bound ones of the bottom level. Relaxed pops leave
+            // marked nodes behind anywhere in the front, so each step also unlinks the marked run it skips, otherwise
+            // they would pile up and every walk would land on them.
+            SPtr Spray(uint32_t bound)
+            {
+                uint64_t steps = bound > 1 ? ThreadRandom::Get().Next(bound) : 0;
+                SPtr node = this->head;
+                for (uint64_t step = 0; step <= steps; ++step)
+                {
+                    SPtr next = node->GetNextPointer(0);
+                    SPtr live = this->SkipMarked(next, 0);
+                    SPtr expected = next;
+                    if (live != next && node->CompareExchange(0, expected, live))
+                    {
+                        this->statistics.Count(Event::Snip);
+                        this->ReleaseRun(next, live, 0);
+                    }
+                    if (!live)
+                    {
+                        break;
+                    }
+                    node = live;
+                }
+                return node == this->head ? SPtr() : node;
+            }
+
+            // With hinted set, predecessors and successors hold the path of an earlier search for a priority no larger
+            // than this one. Levels where that path still brackets the priority keep it, a link that changed since only
+            // fails the CAS of the caller, which then searches without a hint. The levels below start from whichever of
+            // the hint and the node the level above ended at is further. The search covers at least levels levels and
+            // at most the height, levels above are left empty in the path. Unless exact is set, levels above the bottom
+            // stop on the copy of the key of the successor kept next to its link where the node has one, see NodeLink.
+            // Such a copy lags the link only until the change that left it stale finished, see NodeLink. Meanwhile a
+            // level may stop before a successor smaller than the priority, which callers linking there must check, or
+            // before a marked successor, which is left for a later search to unlink.
+            void FindLastOfPriority(const K& priority, uint32_t levels, Path& predecessors, Path& successors,
+                                    bool hinted = false, bool exact = false)
+            {
+                bool marked = false;
+                bool snip = false;
+
+                SPtr predecessor;
+                SPtr current;
+                SPtr successor;
+
+                bool retry;
+                while (true)
+                {
+                    retry = false;
+                    predecessor = this->head;
+                    int64_t height = std::max(this->height.load(), levels);
+                    int64_t top = height - 1;
+                    if (hinted && !predecessors[top])
+                    {
+                        hinted = false;
+                    }
+                    if (!hinted)
+                    {
+                        for (int64_t level = top + 1; level <= L; ++level)
+                        {
+                            predecessors[level] = SPtr();
+                            successors[level] = SPtr();
+                        }
+                    }
+                    else
+                    {
+                        for (; top >= 0; --top)
+                        {
+                            if (successors[top] && Less(successors[top]->GetPriority(), priority))
+                            {
+                                break;
+                            }
+                        }
+                        if (top >= 0)
+                        {
+                            predecessor = predecessors[top];
+                            if (predecessor != this->head && predecessor->IsNextMarked(top))
+                            {
+                                predecessor = this->head;
+                                top = height - 1;
+                            }
+                        }
+                    }
+                    for (int64_t level = top; level >= 0; --level)
+                    {
+                        const SPtr& hint = predecessors[level];
+                        if (hinted && hint != this->head && Less(hint->GetPriority(), priority) &&
+                            !hint->IsNextMarked(level) &&
+                            (predecessor == this->head || Less(predecessor->GetPriority(), hint->GetPriority())))
+                        {
+                            predecessor = hint;
+                        }
+                        current = predecessor->GetNextPointer(level);
+                        uint64_t steps = 0;
+                        while (current)
+                        {
+                            // Marked or not, current is left to the next search
+                            if (!exact && StopsBefore(predecessor, level, priority))
+                            {
+                                break;
+                            }
+                            std::tie(successor, marked) = current->GetNextPointerAndMark(level);
+                            while (marked)
+                            {
+                                // Unlink the whole run of marked nodes with a single CAS
+                                successor = this->SkipMarked(successor, level);
+                                snip = predecessor->CompareExchange(level, current, successor);
+                                if (!snip)
+                                {
+                                    this->statistics.Count(Event::SearchRetry);
+                                    retry = true;
+                                    break;
+                                }
+                                this->statistics.Count(Event::Snip);
+                                this->ReleaseRun(current, successor, level);
+                                current = successor;
+                                if (!current)
+                                {
+                                    marked = false;
+                                }
+                                else
+                                {
+                                    std::tie(successor, marked) = current->GetNextPointerAndMark(level);
+                                }
+                            }
+                            if (retry)
+                            {
+                                break;
+                            }
+                            if (!current)
+                            {
+                                break;
+                            }
+                            if (Less(current->GetPriority(), priority))
+                            {
+                                predecessor = current;
+                                current = successor;
+                                ++steps;
+                            }
+                            else
+                            {
+                                break;
+                            }
+                        }
+                        if (retry)
+                        {
+                            break;
+                        }
+                        this->statistics.Traversed(level, steps);
+                        predecessors[level] = predecessor;
+                        successors[level] = current;
+                    }
+                    if (!retry)
+                    {
+                        break;
+                    }
+                    // Hints may be overwritten by now, search from the head
+                    hinted = false;
+                }
+            }
+
+            SPtr FindFirst()
+            {
+                bool marked = false;
+                bool snip = false;
+
+                SPtr predecessor;
+                SPtr current;
+                SPtr successor;
+
+                bool retry;
+                while (true)
+                {
+                    retry = false;
+                    predecessor = this->head;
+                    uint32_t height = this->height.load();
+                    for (int64_t level = height - 1; level >= 0; --level)
+                    {
+                        current = predecessor->GetNextPointer(level);
+                        if (current)
+                        {
+                            std::tie(successor, marked) = current->GetNextPointerAndMark(level);
+                            while (marked)
+                            {
+                                // Unlink the whole run of marked nodes with a single CAS
+                                successor = this->SkipMarked(successor, level);
+                                snip = predecessor->CompareExchange(level, current, successor);
+                                if (!snip)
+                                {
+                                    this->statistics.Count(Event::FirstRetry);
+                                    retry = true;
+                                    break;
+                                }
+                                this->statistics.Count(Event::Snip);
+                                this->ReleaseRun(current, successor, level);
+                                current = successor;
+                                if (!current)
+                                {
+                                    marked = false;
+                                }
+                                else
+                                {
+                                    std::tie(successor, marked) = current->GetNextPointerAndMark(level);
+                                }
+                            }
+                            if (retry)
+                            {
+                                break;
+                            }
+                            if (level == 0)
+                            {
+                                return current;
+                            }
+                        }
+                        else if (level == 0)
+                        {
+                            return SPtr();
+                        }
+                        else if (level == height - 1)
+                        {
+                            this->LowerHeight(height);
+                        }
+                    }
+                }
+            }
+
+            // The first node pops start from. With eager deletion the marked prefix is unlinked first, with lazy
+            // deletion it is walked over and only unlinked once it grew to the threshold. Either way no node before the
+            // one returned is live.
+            SPtr Front()
+            {
+                if (!Deletion::threshold)
+                {
+                    return this->FindFirst();
+                }
+                bool marked = false;
+                SPtr successor;
+                SPtr node = this->head->GetNextPointer(0);
+                for (uint32_t skipped = 0; node; ++skipped)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (!marked)
+                    {
+                        break;
+                    }
+                    if (skipped + 1 >= Deletion::threshold)
+                    {
+                        return this->FindFirst();
+                    }
+                    node = successor;
+                }
+                return node;
+            }
+
+            // The last node of the bottom level with a key smaller than priority, or the head, found from the top
+            // level down like a search but only reading. Nothing is unlinked. Above the bottom level the walk stops
+            // before popped nodes: one unlinked from the bottom level by a relaxed pop or a search stopping early may
+            // still be linked above, while its bottom link points at nodes already freed. At the bottom level they are
+            // walked over, every node there was reached from a live one under the guard of the caller.
+            SPtr Before(const K& priority) const
+            {
+                SPtr predecessor = this->head;
+                for (int64_t level = this->height.load() - 1; level >= 0; --level)
+                {
+                    SPtr current = predecessor->GetNextPointer(level);
+                    while (current && !StopsBefore(predecessor, level, priority) &&
+                           Less(current->GetPriority(), priority) && (!level || !current->IsNextMarked(0)))
+                    {
+                        predecessor = current;
+                        current = current->GetNextPointer(level);
+                    }
+                }
+                return predecessor;
+            }
+
+            // A key no smaller than the last node of every level of the new node, or no larger than the first node of
+            // each, is linked there without a search. Only the levels of the new node are looked at, and a path that
+            // changed since fails the CAS of the bottom level like a stale hint does. Returns true once the bottom
+            // level is linked, false leaves the rest to a full search.
+            bool LinkAtEnd(const SPtr& new_node, Path& predecessors, Path& successors)
+            {
+                const K priority = new_node->GetPriority();
+                uint32_t new_level = new_node->GetLevel();
+                SPtr tail = this->tails[0].load();
+                if (tail && !Less(priority, tail->GetPriority()))
+                {
+                    for (uint32_t level = 0; level < new_level; ++level)
+                    {
+                        SPtr last = level ? this->tails[level].load() : tail;
+                        if (!last || Less(priority, last->GetPriority()) || last->GetNextPointer(level))
+                        {
+                            return false;
+                        }
+                        predecessors[level] = last;
+                        successors[level] = SPtr();
+                    }
+                }
+                else
+                {
+                    for (uint32_t level = 0; level < new_level; ++level)
+                    {
+                        SPtr first = this->head->GetNextPointer(level);
+                        if (first && Less(first->GetPriority(), priority))
+                        {
+                            return false;
+                        }
+                        predecessors[level] = this->head;
+                        successors[level] = first;
+                    }
+                }
+                for (uint32_t level = 0; level < new_level; ++level)
+                {
+                    new_node->SetNext(level, successors[level]);
+                }
+                // Levels above are not searched, the path must not serve as a hint there
+                for (uint32_t level = new_level; level <= L; ++level)
+                {
+                    predecessors[level] = SPtr();
+                    successors[level] = SPtr();
+                }
+                return predecessors[0]->CompareExchange(0, successors[0], new_node);
+            }
+
+            // Links a new node at all of its levels. The path is left pointing at the node, so it can serve as the hint
+            // for a following priority no smaller than this one.
+            void Link(const SPtr& new_node, Path& predecessors, Path& successors, bool hinted)
+            {
+                const K priority = new_node->GetPriority();
+                uint32_t new_level = new_node->GetLevel();
+                this->RaiseHeight(new_level);
+                if (hinted || !this->LinkAtEnd(new_node, predecessors, successors))
+                {
+                    while (true)
+                    {
+                        this->FindLastOfPriority(priority, new_level, predecessors, successors, hinted);
+                        // The kept part of a hinted path may be what fails the CAS, retries search properly
+                        hinted = false;
+                        for (uint32_t level = 0; level < new_level; ++level)
+                        {
+                            new_node->SetNext(level, successors[level]);
+                        }
+                        if (predecessors[0]->CompareExchange(0, successors[0], new_node))
+                        {
+                            break;
+                        }
+                        this->statistics.Count(Event::LinkRetry);
+                    }
+                }
+                for (uint32_t level = 1; level < new_level; ++level)
+                {
+                    while (true)
+                    {
+                        // A search that stopped on a lagging copy of a key may end short of the place at this level
+                        if (successors[level] && Less(successors[level]->GetPriority(), priority))
+                        {
+                            this->FindLastOfPriority(priority, new_level, predecessors, successors, false, true);
+                            continue;
+                        }
+                        // A failed CAS searches again, which may change successors of every level above this one
+                        new_node->SetNext(level, successors[level]);
+                        if (predecessors[level]->CompareExchange(level, successors[level], new_node))
+                        {
+                            break;
+                        }
+                        this->statistics.Count(Event::LevelRetry);
+                        this->FindLastOfPriority(priority, new_level, predecessors, successors);
+                    }
+                }
+                // The height may have been lowered while the node was linked above it
+                this->RaiseHeight(new_level);
+                new_node->SetDoneInserting();
+                for (uint32_t level = 0; level < new_level; ++level)
+                {
+                    if (!successors[level])
+                    {
+                        Reclamation::template Publish<Allocator>(this->tails[level], new_node);
+                    }
+                    predecessors[level] = new_node;
+                }
+            }
+
+            // Inserts elements sorted in queue order by key, every search starting from the path of the previous key.
+            // Unsorted elements are still inserted where they belong, only with longer searches. Values are moved out of
+            // items. Bounded queues insert one element at a time, waiting for room must not happen inside the guard.
+            void PushSorted(std::vector<std::pair<K, V>>& items)
+            {
+                if (this->max_size)
+                {
+                    for (std::pair<K, V>& item : items)
+                    {
+                        this->Push(item.first, std::move(item.second));
+                    }
+                    return;
+                }
+
+                Guard guard;
+                Path predecessors;
+                Path successors;
+                bool hinted = false;
+                for (size_t i = 0; i < items.size(); ++i)
+                {
+                    if (this->PushTie(items[i].first, predecessors, successors, hinted, std::move(items[i])))
+                    {
+                        continue;
+                    }
+                    uint32_t new_level = this->GenerateRandomLevel();
+                    SPtr new_node = this->MakeNode(items[i].first, new_level, std::move(items[i].second));
+                    this->Link(new_node, predecessors, successors, hinted);
+                    this->Pushed();
+                    hinted = true;
+                }
+            }
+
+            // Takes every node still holding an element out of a queue no other thread uses, in order, and leaves the
+            // queue empty. Popped nodes are freed. The nodes taken keep one link per level for their next queue.
+            // Returns how many elements they hold, ties included.
+            size_t Detach(std::vector<SPtr>& nodes)
+            {
+                size_t count = 0;
+                bool marked = false;
+                SPtr successor;
+                for (SPtr node = this->head->GetNextPointer(0); node; node = successor)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (marked)
+                    {
+                        continue;
+                    }
+                    for (int slot = node->NextTie(0); slot >= 0; slot = node->NextTie(slot + 1))
+                    {
+                        ++count;
+                    }
+                    ++count;
+                    nodes.push_back(node);
+                }
+                for (const SPtr& node : nodes)
+                {
+                    for (int level = 0; level < node->GetLevel(); ++level)
+                    {
+                        Reclamation::template Hold<Allocator>(node);
+                    }
+                }
+                this->DropTails();
+                Reclamation::template Destroy<Allocator>(this->head, L + 1);
+                this->head = MakeNode(K(), L + 1);
+                this->size.Set(0);
+                this->height = 1;
+                return count;
+            }
+
+            // Links a node taken from another queue by Detach, counting the elements it holds
+            void Relink(const SPtr& node, Path& predecessors, Path& successors, bool hinted)
+            {
+                node->SetInserting();
+                this->Link(node, predecessors, successors, hinted);
+                for (int slot = node->NextTie(0); slot >= 0; slot = node->NextTie(slot + 1))
+                {
+                    this->Pushed();
+                }
+                this->Pushed();
+            }
+
+            // Links the sorted elements that next(record) points record at, one at a time until it returns false, after
+            // the last node of each level in a single pass without searching or CAS. Only for a queue no other thread
+            // uses. Returns false without linking anything if the queue is not empty, and stops and returns false at
+            // the first key smaller than the one before it, keeping what was linked so far.
+            template <typename F>
+            bool Build(F next)
+            {
+                Guard guard;
+                if (this->FindFirst())
+                {
+                    return false;
+                }
+                Path last;
+                last.fill(this->head);
+                uint32_t height = 1;
+                int64_t count = 0;
+                bool sorted = true;
+                const char* record = nullptr;
+                while (next(record))
+                {
+                    K priority;
+                    std::memcpy(static_cast<void*>(&priority), record, sizeof(K));
+                    if (count && Less(priority, last[0]->GetPriority()))
+                    {
+                        sorted = false;
+                        break;
+                    }
+                    uint32_t level = this->GenerateRandomLevel();
+                    V data;
+                    std::memcpy(static_cast<void*>(&data), record + sizeof(K), sizeof(V));
+                    SPtr node = this->MakeNode(priority, level, data);
+                    node->SetDoneInserting();
+                    for (uint32_t i = 0; i < level; ++i)
+                    {
+                        last[i]->SetNext(i, node);
+                        last[i] = node;
+                    }
+                    height = std::max(height, level);
+                    ++count;
+                }
+                this->RaiseHeight(height);
+                for (int level = 0; level <= L; ++level)
+                {
+                    if (last[level] != this->head)
+                    {
+                        Reclamation::template Publish<Allocator>(this->tails[level], last[level]);
+                    }
+                }
+                this->size.Add(count);
+                return sorted;
+            }
+
+            static CheckpointHeader Header()
+            {
+                static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                              "Key and value types must be trivially copyable to checkpoint");
+                return CheckpointHeader::For(sizeof(K), sizeof(V));
+            }
+
+            // Passes the header and then every key and value in order to write(bytes, size), returns how many elements
+            // there were
+            template <typename F>
+            size_t Write(F write) const
+            {
+                CheckpointHeader header = Header();
+                write(reinterpret_cast<const char*>(&header), sizeof(header));
+                size_t count = 0;
+                for (Iterator it = this->begin(); it.node; ++it)
+                {
+                    write(reinterpret_cast<const char*>(&it->first), sizeof(K));
+                    write(reinterpret_cast<const char*>(it->second), sizeof(V));
+                    ++count;
+                }
+                return count;
+            }
+
+            void DropTails()
+            {
+                for (int level = 0; level <= L; ++level)
+                {
+                    Reclamation::template Drop<Allocator>(this->tails[level]);
+                }
+            }
+
+        public:
+            // Pops come out in this order, the smallest first under it
+            typedef typename T::Compare Compare;
+
+            // Refers to an element pushed with PushWithHandle, for Erase and UpdatePriority on the same queue. The node
+            // stays allocated while a handle to it lives, even once the element left the queue.
+            class Handle
+            {
+                friend class KVQueue;
+                private:
+                    SPtr node;
+
+                    explicit Handle(const SPtr& node) : node(node)
+                    {
+                        Reclamation::template Hold<Allocator>(this->node);
+                    }
+
+                public:
+                    Handle() : node()
+                    {
+                    }
+
+                    Handle(const Handle& other) : node(other.node)
+                    {
+                        if (this->node)
+                        {
+                            Reclamation::template Hold<Allocator>(this->node);
+                        }
+                    }
+
+                    Handle(Handle&& other) noexcept : node(other.node)
+                    {
+                        other.node = SPtr();
+                    }
+
+                    Handle& operator=(Handle other) noexcept
+                    {
+                        std::swap(this->node, other.node);
+                        return *this;
+                    }
+
+                    ~Handle()
+                    {
+                        if (this->node)
+                        {
+                            Reclamation::template Unlinked<Allocator>(this->node);
+                        }
+                    }
+
+                    bool IsValid() const
+                    {
+                        return static_cast<bool>(this->node);
+                    }
+            };
+
+            // A forward iterator over the elements in the queue from the smallest on, ties included, as pairs of the key
+            // and a pointer to the value. Weakly consistent and bound to its thread like Queue::Iterator. Pops move
+            // values out of their nodes while it may read them, which only leaves the value alone if V is trivially
+            // copyable, so only such values can be iterated.
+            class Iterator
+            {
+                friend class KVQueue;
+                private:
+                    Guard guard;
+                    SPtr node;
+                    int slot;
+                    std::pair<K, const V*> element;
+
+                    explicit Iterator(const SPtr& node) : guard(), node(node), slot(-1), element()
+                    {
+                        this->Seek();
+                    }
+
+                    // From node on, stops at the first node neither popped nor being inserted
+                    void Seek()
+                    {
+                        while (this->node && (this->node->IsNextMarked(0) || this->node->IsInserting()))
+                        {
+                            this->node = this->node->GetNextPointer(0);
+                        }
+                        if (this->node)
+                        {
+                            this->slot = this->node->NextTie(0);
+                            this->Load();
+                        }
+                        else
+                        {
+                            this->slot = -1;
+                        }
+                    }
+
+                    void Load()
+                    {
+                        static_assert(std::is_trivially_copyable<V>::value,
+                                      "Value type must be trivially copyable to be read while other threads pop");
+                        this->element.first = this->node->GetPriority(this->slot);
+                        this->element.second = &this->node->GetData(this->slot);
+                    }
+
+                public:
+                    typedef std::forward_iterator_tag iterator_category;
+                    typedef std::pair<K, const V*> value_type;
+                    typedef std::ptrdiff_t difference_type;
+                    typedef const value_type* pointer;
+                    typedef const value_type& reference;
+
+                    Iterator() : guard(), node(), slot(-1), element()
+                    {
+                    }
+
+                    reference operator*() const
+                    {
+                        return this->element;
+                    }
+
+                    pointer operator->() const
+                    {
+                        return &this->element;
+                    }
+
+                    // Ties of a node come before its own element, the order pops take them in
+                    Iterator& operator++()
+                    {
+                        if (this->slot >= 0)
+                        {
+                            this->slot = this->node->NextTie(this->slot + 1);
+                            if (this->slot >= 0 || !this->node->IsNextMarked(0))
+                            {
+                                this->Load();
+                                return *this;
+                            }
+                        }
+                        this->node = this->node->GetNextPointer(0);
+                        this->Seek();
+                        return *this;
+                    }
+
+                    Iterator operator++(int)
+                    {
+                        Iterator old(*this);
+                        ++*this;
+                        return old;
+                    }
+
+                    bool operator==(const Iterator& other) const
+                    {
+                        return this->node == other.node && this->slot == other.slot;
+                    }
+
+                    bool operator!=(const Iterator& other) const
+                    {
+                        return !(*this == other);
+                    }
+            };
+
+            typedef Iterator iterator;
+            typedef Iterator const_iterator;
+
+            KVQueue(uint64_t max_size = 0) : max_size(max_size),
+                    head(MakeNode(K(), L + 1)), size(), height(1)
+            {
+            }
+
+            ~KVQueue()
+            {
+                this->DropTails();
+                Reclamation::template Destroy<Allocator>(this->head, L + 1);
+            }
+
+            KVQueue(const KVQueue&) = delete;
+
+            KVQueue(KVQueue&& other)  noexcept : max_size(other.max_size), head(other.head),
+                    size(), height(other.height.load())
+            {
+                this->size.Set(other.size.Get());
+                other.DropTails();
+                other.head = nullptr;
+                other.size.Set(0);
+            }
+
+            KVQueue& operator=(const KVQueue&) = delete;
+
+            KVQueue& operator=(KVQueue&& other) noexcept
+            {
+                this->DropTails();
+                other.DropTails();
+                Reclamation::template Destroy<Allocator>(this->head, L + 1);
+                this->max_size = other.max_size;
+                this->head = other.head;
+                this->size.Set(other.size.Get());
+                this->height = other.height.load();
+                other.head = nullptr;
+                other.size.Set(0);
+                return *this;
+            }
+
+            void Push(const K& priority)
+            {
+                this->Emplace(priority);
+            }
+
+            void Push(const K& priority, const V& data)
+            {
+                this->Emplace(priority, data);
+            }
+
+            void Push(const K& priority, V&& data)
+            {
+                this->Emplace(priority, std::move(data));
+            }
+
+            // Constructs the value in place inside the node from args
+            template <typename... Args>
+            void Emplace(const K& priority, Args&&... args)
+            {
+                this->Wait();
+                Guard guard;
+                Path predecessors;
+                Path successors;
+                bool hinted = false;
+                if (this->PushTie(priority, predecessors, successors, hinted, std::piecewise_construct,
+                                  std::forward_as_tuple(priority), std::forward_as_tuple(std::forward<Args>(args)...)))
+                {
+                    return;
+                }
+                uint32_t new_level = this->GenerateRandomLevel();
+                SPtr new_node = this->MakeNode(priority, new_level, std::forward<Args>(args)...);
+                this->Link(new_node, predecessors, successors, hinted);
+                this->Pushed();
+            }
+
+            // Like Emplace, but returns a handle to the element. It always gets a node of its own, even with tie buckets.
+            template <typename... Args>
+            Handle EmplaceWithHandle(const K& priority, Args&&... args)
+            {
+                this->Wait();
+                Guard guard;
+                Path predecessors;
+                Path successors;
+                SPtr new_node = this->MakeNode(priority, this->GenerateRandomLevel(), std::forward<Args>(args)...);
+                new_node->CloseTies();
+                // Held before linking, a pop may free the node as soon as it is linked
+                Handle handle(new_node);
+                this->Link(new_node, predecessors, successors, false);
+                this->Pushed();
+                return handle;
+            }
+
+            Handle PushWithHandle(const K& priority, const V& data)
+            {
+                return this->EmplaceWithHandle(priority, data);
+            }
+
+            Handle PushWithHandle(const K& priority, V&& data)
+            {
+                return this->EmplaceWithHandle(priority, std::move(data));
+            }
+
+            // Removes the element of the handle, fails if it was popped or erased already
+            bool Erase(const Handle& handle)
+            {
+                Guard guard;
+                return this->Remove(handle.node);
+            }
+
+            // Erases the element of the handle and pushes its value again with a new key, after which the handle refers
+            // to the new element. Fails if the element was popped or erased already. Other threads may miss the element
+            // while it moves.
+            bool UpdatePriority(Handle& handle, const K& priority)
+            {
+                if (!this->Erase(handle))
+                {
+                    return false;
+                }
+                // Winning the mark makes the value ours, and the handle keeps the old node allocated
+                handle = this->EmplaceWithHandle(priority, handle.node->MoveData());
+                return true;
+            }
+
+            // Inserts the key value pairs of a range, anything convertible to std::pair<K, V> works and a
+            // std::move_iterator moves the values in. The batch is sorted
+            // by key first and every search starts from the path of the previous key, so the whole batch costs about
+            // one pass over the list instead of a search from the head per key. Bounded queues insert one pair at a
+            // time, waiting for room must not happen inside the guard.
+            template <typename It>
+            void PushBulk(It first, It last)
+            {
+                std::vector<std::pair<K, V>> items;
+                for (; first != last; ++first)
+                {
+                    items.emplace_back(*first);
+                }
+                std::sort(items.begin(), items.end(), [](const std::pair<K, V>& a, const std::pair<K, V>& b)
+                {
+                    return Less(a.first, b.first);
+                });
+                this->PushSorted(items);
+            }
+
+            bool TryPop(K& priority, V& data)
+            {
+                Guard guard;
+                SPtr successor;
+                SPtr first = this->Front();
+
+                if (!first)
+                {
+                    return false;
+                }
+                int slot = first->TryPopTie();
+                if (slot >= 0)
+                {
+                    priority = first->GetPriority(slot);
+                    data = first->MoveData(slot);
+                    this->Popped();
+                    return true;
+                }
+                if (first->IsInserting())
+                {
+                    this->statistics.Count(Event::Inserting);
+                    return false;
+                }
+                if (!first->CloseTies())
+                {
+                    return false;
+                }
+
+                for (uint32_t level = first->GetLevel() - 1; level >= 1; --level)
+                {
+                    first->SetNextMark(level);
+                }
+
+                successor = first->GetNextPointer(0);
+                priority = first->GetPriority();
+                bool success = first->TestAndSetMark(0, successor);
+                if (success)
+                {
+                    data = first->MoveData();
+                    this->Popped();
+                    return true;
+                }
+                else
+                {
+                    this->statistics.Count(Event::LostMark);
+                    return false;
+                }
+            }
+
+            // Unlike TryPop, fails only if there is nothing to pop. A node still being inserted is skipped, its push
+            // has not returned yet, and a lost race moves on to the next node instead of giving up.
+            bool TryPopStrong(K& priority, V& data)
+            {
+                Guard guard;
+                int slot;
+                SPtr node = this->Claim(this->Front(), slot);
+                if (!node)
+                {
+                    return false;
+                }
+                priority = node->GetPriority(slot);
+                data = node->MoveData(slot);
+                return true;
+            }
+
+            // Pops one of roughly the bound smallest elements instead of the smallest one, so that concurrent consumers
+            // spread over the front of the queue instead of all fighting over the first node. Fails only if there is
+            // nothing to pop, a bound of 1 behaves like TryPopStrong.
+            bool TryPopRelaxed(K& priority, V& data, uint32_t bound = 16)
+            {
+                Guard guard;
+                int slot;
+                SPtr node = this->Claim(this->Spray(bound), slot);
+                if (!node)
+                {
+                    // Nothing left from the landing node on, look from the front
+                    return this->TryPopStrong(priority, data);
+                }
+                priority = node->GetPriority(slot);
+                data = node->MoveData(slot);
+                return true;
+            }
+
+            // Pops up to n of the smallest elements in a single walk over the bottom level, writing std::pair<K, V> to
+            // out. Claimed nodes are unlinked together afterwards, one CAS per level for the whole run, or with lazy
+            // deletion once the marked prefix reached the threshold. Returns how many elements were popped, nodes still
+            // being inserted are skipped like in TryPopStrong.
+            template <typename OutputIt>
+            size_t TryPopN(OutputIt out, size_t n)
+            {
+                Guard guard;
+                size_t count = 0;
+                SPtr node = n ? this->Front() : SPtr();
+                int slot;
+
+                while (count < n && (node = this->Claim(node, slot)))
+                {
+                    *out = std::make_pair(node->GetPriority(slot), node->MoveData(slot));
+                    ++out;
+                    ++count;
+                    // Marked links no longer change, this is the successor the mark was set on. A popped tie leaves
+                    // the node in place.
+                    if (slot < 0)
+                    {
+                        node = node->GetNextPointer(0);
+                    }
+                }
+                if (count)
+                {
+                    this->Front();
+                }
+                return count;
+            }
+
+            // Pops every element in order in a single walk, like TryPopN without a bound. Returns how many elements were
+            // popped.
+            template <typename OutputIt>
+            size_t DrainTo(OutputIt out)
+            {
+                return this->TryPopN(out, std::numeric_limits<size_t>::max());
+            }
+
+            // Moves up to max of the smallest elements of victim into this queue, at most half of what it holds rounded
+            // up, and returns how many moved. They leave victim in a single walk like TryPopN, values moved out of
+            // their nodes, and are linked here in order like PushBulk. Both queues may be used by other threads
+            // meanwhile, which may find the elements in neither queue while they move.
+            size_t StealHalf(KVQueue& victim, size_t max = std::numeric_limits<size_t>::max())
+            {
+                if (&victim == this)
+                {
+                    return 0;
+                }
+                int64_t count = victim.Count();
+                size_t n = std::min(max, count > 0 ? static_cast<size_t>(count + 1) / 2 : 0);
+                std::vector<std::pair<K, V>> stolen;
+                stolen.reserve(n);
+                victim.TryPopN(std::back_inserter(stolen), n);
+                this->PushSorted(stolen);
+                return stolen.size();
+            }
+
+            // Moves every element of other into this queue and returns how many moved. other is given up, no other
+            // thread may use it while it is merged, and it is left empty. The elements move with their nodes, popped
+            // nodes are freed and the rest are linked here in order, every search starting from the path of the
+            // previous node. A merge costs about one pass over each list and allocates no nodes. Other threads may use
+            // this queue meanwhile. Handles to elements of other refer to them in this queue afterwards.
+            size_t Merge(KVQueue&& other)
+            {
+                if (&other == this)
+                {
+                    return 0;
+                }
+                std::vector<SPtr> nodes;
+                size_t count = other.Detach(nodes);
+                Path predecessors;
+                Path successors;
+                if (!this->max_size)
+                {
+                    Guard guard;
+                    bool hinted = false;
+                    for (const SPtr& node : nodes)
+                    {
+                        this->Relink(node, predecessors, successors, hinted);
+                        hinted = true;
+                    }
+                    return count;
+                }
+                // Waiting for room must not happen inside the guard
+                for (const SPtr& node : nodes)
+                {
+                    this->Wait();
+                    Guard guard;
+                    this->Relink(node, predecessors, successors, false);
+                }
+                return count;
+            }
+
+            // Removes every element in a single walk and returns how many there were. Elements are marked like pops,
+            // then the whole marked prefix is unlinked with one CAS per level. Values are not moved out, they are
+            // destroyed with their nodes. With SharedReclamation the nodes are freed by this call, with
+            // EpochReclamation they are retired and freed by later collections. Elements whose push has not returned
+            // yet stay in the queue.
+            size_t Clear()
+            {
+                Guard guard;
+                size_t count = 0;
+                SPtr node = this->Front();
+                int slot;
+
+                while ((node = this->Claim(node, slot)))
+                {
+                    ++count;
+                    if (slot < 0)
+                    {
+                        node = node->GetNextPointer(0);
+                    }
+                }
+                if (count)
+                {
+                    this->FindFirst();
+                }
+                return count;
+            }
+
+            // Reads only the smallest key, so unlike the overload with a value it is safe next to pops for any V
+            bool TryPeek(K& priority)
+            {
+                Guard guard;
+                bool marked = false;
+                SPtr successor;
+                SPtr node = this->Front();
+                while (node)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (!marked && !node->IsInserting())
+                    {
+                        priority = node->GetPriority();
+                        return true;
+                    }
+                    node = successor;
+                }
+                return false;
+            }
+
+            // Reads the smallest element without popping it, fails only if there is nothing to pop. Someone else may pop it
+            // right after. With EpochReclamation the walk is plain loads, no reference counts are taken. A pop may move
+            // the value out of the node while it is copied, so V must be trivially copyable, TryPeek(priority) reads
+            // keys of any queue.
+            bool TryPeek(K& priority, V& data)
+            {
+                static_assert(std::is_trivially_copyable<V>::value,
+                              "Value type must be trivially copyable to be read while other threads pop");
+                Guard guard;
+                bool marked = false;
+                SPtr successor;
+                SPtr node = this->Front();
+                while (node)
+                {
+                    std::tie(successor, marked) = node->GetNextPointerAndMark(0);
+                    if (!marked && !node->IsInserting())
+                    {
+                        priority = node->GetPriority();
+                        data = node->GetData();
+                        return true;
+                    }
+                    node = successor;
+                }
+                return false;
+            }
+
+            // Blocks until an element could be popped, spinning for a while before parking the thread
+            void Pop(K& priority, V& data)
+            {
+                while (!this->TryPopStrong(priority, data))
+                {
+                    this->not_empty.Wait([this]() { return this->Count() > 0; });
+                }
+            }
+
+            // Like Pop, but gives up once the timeout passed
+            template <typename Rep, typename Period>
+            bool TryPopFor(K& priority, V& data, const std::chrono::duration<Rep, Period>& timeout)
+            {
+                auto deadline = std::chrono::steady_clock::now() + timeout;
+                while (!this->TryPopStrong(priority, data))
+                {
+                    if (!this->not_empty.WaitUntil([this]() { return this->Count() > 0; }, deadline))
+                    {
+                        return this->TryPopStrong(priority, data);
+                    }
+                }
+                return true;
+            }
+
+            // Approximate while other threads push and pop, and with a striped counter a sum over its stripes
+            uint64_t GetSize() const
+            {
+                int64_t count = this->Count();
+                return count > 0 ? static_cast<uint64_t>(count) : 0;
+            }
+
+            // Contention events and search steps per level counted so far, all zero unless the traits enable
+            // statistics
+            QueueStats GetStats() const
+            {
+                return this->statistics.Get();
+            }
+
+            // From the smallest key on, see Iterator
+            Iterator begin() const
+            {
+                // Pinned until the iterator pins on its own
+                Guard guard;
+                return Iterator(this->head->GetNextPointer(0));
+            }
+
+            Iterator end() const
+            {
+                return Iterator();
+            }
+
+            // Calls fn(key, value) on every element with a key in [lo, hi) in order, ties included, and returns how
+            // many there were. Values are read like through Iterator.
+            template <typename F>
+            size_t ForEachInRange(const K& lo, const K& hi, F fn) const
+            {
+                Guard guard;
+                SPtr predecessor = this->Before(lo);
+                size_t count = 0;
+                for (Iterator it(predecessor->GetNextPointer(0)); it.node && Less(it->first, hi); ++it)
+                {
+                    fn(it->first, *it->second);
+                    ++count;
+                }
+                return count;
+            }
+
+            // Writes every element in order to out as a checkpoint, a CheckpointHeader followed by the raw bytes of
+            // each key and its value, and returns how many were written. Weakly consistent like Iterator, so for a checkpoint of a
+            // moment in time no other thread should push or pop meanwhile.
+            size_t Serialize(std::ostream& out) const
+            {
+                return this->Write([&](const char* bytes, size_t size)
+                {
+                    out.write(bytes, size);
+                });
+            }
+
+            // Like Serialize to a stream, appending to buffer
+            size_t Serialize(std::vector<char>& buffer) const
+            {
+                return this->Write([&](const char* bytes, size_t size)
+                {
+                    buffer.insert(buffer.end(), bytes, bytes + size);
+                });
+            }
+
+            // Rebuilds the queue from a checkpoint in memory, such as a MappedFile, in O(n): nodes are linked bottom up
+            // in the order they are read, straight from data without copying the checkpoint. Only for an empty queue
+            // no other thread uses yet, and max_size is not enforced. Fails if the queue is not empty, the header does
+            // not match K and V, or the size is not a whole number of elements, all before restoring anything, or at
+            // the first key out of order, keeping the elements before it.
+            bool Restore(const void* data, size_t size)
+            {
+                CheckpointHeader header;
+                if (size < sizeof(header))
+                {
+                    return false;
+                }
+                std::memcpy(&header, data, sizeof(header));
+                if (!header.Matches(this->Header()) || (size - sizeof(header)) % header.RecordSize())
+                {
+                    return false;
+                }
+                const char* position = static_cast<const char*>(data) + sizeof(header);
+                const char* end = static_cast<const char*>(data) + size;
+                return this->Build([&](const char*& record) -> bool
+                {
+                    if (position == end)
+                    {
+                        return false;
+                    }
+                    record = position;
+                    position += header.RecordSize();
+                    return true;
+                });
+            }
+
+            bool Restore(const MappedFile& file)
+            {
+                return file.IsValid() && this->Restore(file.Data(), file.Size());
+            }
+
+            // Like Restore from memory, reading one element at a time from in. Also fails if the stream ends inside an
+            // element.
+            bool Restore(std::istream& in)
+            {
+                CheckpointHeader header;
+                if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || !header.Matches(this->Header()))
+                {
+                    return false;
+                }
+                char buffer[sizeof(K) + sizeof(V)];
+                bool truncated = false;
+                bool sorted = this->Build([&](const char*& record) -> bool
+                {
+                    in.read(buffer, sizeof(buffer));
+                    truncated = in.gcount() && in.gcount() != static_cast<std::streamsize>(sizeof(buffer));
+                    record = buffer;
+                    return in.gcount() == static_cast<std::streamsize>(sizeof(buffer));
+                });
+                return sorted && !truncated;
             }
 
             std::string ToString(bool all_levels = false)
             {
                 static_assert(is_printable<K>::value, "Key type must be printable");
                 static_assert(is_printable<V>::value, "Value type must be printable");
+                Guard guard;
                 std::stringstream ss;
                 uint32_t max = all_levels? L : 0;
                 for (uint32_t level = 0; level <= max; ++level)
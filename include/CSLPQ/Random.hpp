@@ -0,0 +1,114 @@
+#ifndef __CSLPQ_RANDOM_HPP__
+#define __CSLPQ_RANDOM_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+namespace CSLPQ
+{
+    // One fast generator per thread, seeded from a splitmix64 sequence so that threads never share state or a
+    // cache line on the push path.
+    class ThreadRandom
+    {
+        private:
+            uint64_t state;
+
+            static uint64_t SplitMix64(uint64_t& x)
+            {
+                uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                return z ^ (z >> 31);
+            }
+
+            static uint64_t InitialSeed()
+            {
+                std::random_device device;
+                return ((uint64_t)device() << 32) ^ device() ^
+                       (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+            }
+
+            static uint64_t NextSeed()
+            {
+                static std::atomic<uint64_t> sequence(InitialSeed());
+                uint64_t x = sequence.fetch_add(0x9E3779B97F4A7C15ULL);
+                return SplitMix64(x);
+            }
+
+            ThreadRandom() : state(NextSeed())
+            {
+                if (!this->state)
+                {
+                    this->state = 0x9E3779B97F4A7C15ULL;
+                }
+            }
+
+        public:
+            ThreadRandom(const ThreadRandom&) = delete;
+            ThreadRandom& operator=(const ThreadRandom&) = delete;
+
+            static ThreadRandom& Get()
+            {
+                static thread_local ThreadRandom random;
+                return random;
+            }
+
+            // xorshift64*
+            uint64_t Next()
+            {
+                this->state ^= this->state >> 12;
+                this->state ^= this->state << 25;
+                this->state ^= this->state >> 27;
+                return this->state * 0x2545F4914F6CDD1DULL;
+            }
+
+            // Uniform in [0, bound), bound must be non zero
+            uint64_t Next(uint64_t bound)
+            {
+                return this->Next() % bound;
+            }
+    };
+
+    inline uint32_t CountTrailingZeros(uint64_t x)
+    {
+#if defined(__clang__) || defined(__GNUC__) || defined(__GNUG__)
+        return x ? __builtin_ctzll(x) : 64;
+#else
+        uint32_t count = 0;
+        while (count < 64 && !(x & 1))
+        {
+            x >>= 1;
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    // Levels follow a geometric distribution, a node reaches level i + 1 with probability 1 / D ^ i. D must be a power
+    // of two, D = 2 gives the classic skiplist, D = 4 gives shorter towers and less CAS work per push.
+    template <uint32_t D = 2>
+    struct GeometricLevel
+    {
+        static_assert(D >= 2 && (D & (D - 1)) == 0, "Geometric level ratio must be a power of two");
+
+        static uint32_t Generate(uint32_t max_level)
+        {
+            uint32_t bits = CountTrailingZeros(D);
+            uint32_t level = 1 + CountTrailingZeros(ThreadRandom::Get().Next()) / bits;
+            return level < max_level ? level : max_level;
+        }
+    };
+
+    // The original distribution, every level is equally likely.
+    struct UniformLevel
+    {
+        static uint32_t Generate(uint32_t max_level)
+        {
+            return 1 + (uint32_t)ThreadRandom::Get().Next(max_level);
+        }
+    };
+}
+
+#endif // __CSLPQ_RANDOM_HPP__
@@ -0,0 +1,548 @@
+#ifndef __CSLPQ_RECLAMATION_HPP__
+#define __CSLPQ_RECLAMATION_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Pointers.hpp"
+
+namespace CSLPQ
+{
+    // An atomic pointer with a deletion mark in its low bit. It mirrors the interface of
+    // jss::markable_atomic_shared_ptr so nodes can use either, but every load is a plain acquire load.
+    template <typename T>
+    class MarkableAtomicPtr
+    {
+        private:
+            static const uintptr_t mark_bit = 1;
+
+            std::atomic<uintptr_t> value;
+
+            static T* Pointer(uintptr_t value)
+            {
+                return reinterpret_cast<T*>(value & ~mark_bit);
+            }
+
+        public:
+            MarkableAtomicPtr() noexcept : value(0)
+            {
+            }
+
+            explicit MarkableAtomicPtr(T* pointer) noexcept : value(reinterpret_cast<uintptr_t>(pointer))
+            {
+            }
+
+            MarkableAtomicPtr(const MarkableAtomicPtr&) = delete;
+            MarkableAtomicPtr& operator=(const MarkableAtomicPtr&) = delete;
+
+            T* load(std::memory_order order = std::memory_order_acquire) const noexcept
+            {
+                return Pointer(this->value.load(order));
+            }
+
+            bool is_marked(std::memory_order order = std::memory_order_acquire) const noexcept
+            {
+                return this->value.load(order) & mark_bit;
+            }
+
+            std::pair<T*, bool> load_marked(std::memory_order order = std::memory_order_acquire) const noexcept
+            {
+                uintptr_t current = this->value.load(order);
+                return std::make_pair(Pointer(current), (current & mark_bit) != 0);
+            }
+
+            void store(T* pointer, std::memory_order order = std::memory_order_release) noexcept
+            {
+                this->value.store(reinterpret_cast<uintptr_t>(pointer), order);
+            }
+
+            T* operator=(T* pointer) noexcept
+            {
+                this->store(pointer);
+                return pointer;
+            }
+
+            T* exchange(T* pointer) noexcept
+            {
+                return Pointer(this->value.exchange(reinterpret_cast<uintptr_t>(pointer)));
+            }
+
+            void set_mark() noexcept
+            {
+                this->value.fetch_or(mark_bit);
+            }
+
+            // Marks whatever the pointer currently holds, fails only if it was already marked. expected is set to
+            // the current pointer.
+            bool test_and_set_mark(T*& expected) noexcept
+            {
+                uintptr_t old_value = this->value.fetch_or(mark_bit);
+                expected = Pointer(old_value);
+                return !(old_value & mark_bit);
+            }
+
+            // Succeeds only if the pointer is unmarked and equal to expected, on failure expected is set to the
+            // current pointer.
+            bool compare_exchange_weak(T*& expected, T* desired) noexcept
+            {
+                uintptr_t old_value = reinterpret_cast<uintptr_t>(expected);
+                if (this->value.compare_exchange_strong(old_value, reinterpret_cast<uintptr_t>(desired)))
+                {
+                    return true;
+                }
+                expected = Pointer(old_value);
+                return false;
+            }
+    };
+
+    // Epoch based reclamation shared by every queue in the process. Threads pin the global epoch for the duration of
+    // an operation, unlinked nodes are retired with the epoch they were retired in and freed once the global epoch
+    // moved two steps past it, at which point no pinned thread can still hold a reference.
+    class EpochDomain
+    {
+        private:
+            static const uint64_t active_bit = 1;
+            static const uint32_t collect_interval = 64;
+
+            struct Retired
+            {
+                void* pointer;
+                void (*deleter)(void*);
+                uint64_t epoch;
+            };
+
+            // Heap allocated, so the state is padded on both sides instead of over aligned
+            struct Record
+            {
+                char padding_before[64];
+                std::atomic<uint64_t> state;
+                char padding_after[64];
+                std::atomic<bool> in_use;
+                Record* next;
+                uint32_t nesting;
+                uint32_t since_collect;
+                // Epoch of the last walk over retired
+                uint64_t collected;
+                std::vector<Retired> retired;
+
+                Record() : state(0), in_use(true), next(nullptr), nesting(0), since_collect(0), collected(0)
+                {
+                }
+            };
+
+            class ThreadState
+            {
+                private:
+                    EpochDomain& domain;
+
+                public:
+                    Record* record;
+
+                    explicit ThreadState(EpochDomain& domain) : domain(domain), record(domain.Acquire())
+                    {
+                    }
+
+                    ~ThreadState()
+                    {
+                        this->domain.Release(this->record);
+                    }
+            };
+
+            char padding_before[64];
+            std::atomic<uint64_t> epoch;
+            char padding_after[64];
+            std::atomic<Record*> records;
+            std::mutex orphans_mutex;
+            std::vector<Retired> orphans;
+
+            EpochDomain() : epoch(0), records(nullptr)
+            {
+            }
+
+            Record* Acquire()
+            {
+                for (Record* record = this->records.load(); record; record = record->next)
+                {
+                    bool expected = false;
+                    if (!record->in_use.load() && record->in_use.compare_exchange_strong(expected, true))
+                    {
+                        return record;
+                    }
+                }
+                Record* record = new Record();
+                Record* head = this->records.load();
+                do
+                {
+                    record->next = head;
+                }
+                while (!this->records.compare_exchange_weak(head, record));
+                return record;
+            }
+
+            void Release(Record* record)
+            {
+                this->Collect(record);
+                if (!record->retired.empty())
+                {
+                    std::lock_guard<std::mutex> lock(this->orphans_mutex);
+                    this->orphans.insert(this->orphans.end(), record->retired.begin(), record->retired.end());
+                    record->retired.clear();
+                }
+                record->state.store(0);
+                record->in_use.store(false);
+            }
+
+            Record* Local()
+            {
+                static thread_local ThreadState state(*this);
+                return state.record;
+            }
+
+            bool TryAdvance()
+            {
+                uint64_t current = this->epoch.load();
+                for (Record* record = this->records.load(); record; record = record->next)
+                {
+                    uint64_t state = record->state.load();
+                    if ((state & active_bit) && (state >> 1) != current)
+                    {
+                        return false;
+                    }
+                }
+                return this->epoch.compare_exchange_strong(current, current + 1);
+            }
+
+            // Deleters may retire more pointers, so work on a detached copy of the list.
+            static void Free(std::vector<Retired>& retired, uint64_t current_epoch)
+            {
+                std::vector<Retired> pending;
+                pending.swap(retired);
+                for (size_t i = 0; i < pending.size(); ++i)
+                {
+                    if (pending[i].epoch + 2 <= current_epoch)
+                    {
+                        pending[i].deleter(pending[i].pointer);
+                    }
+                    else
+                    {
+                        retired.push_back(pending[i]);
+                    }
+                }
+            }
+
+            void Collect(Record* record)
+            {
+                record->since_collect = 0;
+                this->TryAdvance();
+                uint64_t current = this->epoch.load();
+                record->collected = current;
+                Free(record->retired, current);
+                std::unique_lock<std::mutex> lock(this->orphans_mutex, std::try_to_lock);
+                if (lock.owns_lock() && !this->orphans.empty())
+                {
+                    Free(this->orphans, current);
+                }
+            }
+
+        public:
+            EpochDomain(const EpochDomain&) = delete;
+            EpochDomain& operator=(const EpochDomain&) = delete;
+
+            // Never destroyed, nodes of queues with static storage may still be retired during exit.
+            static EpochDomain& Get()
+            {
+                static EpochDomain* domain = new EpochDomain();
+                return *domain;
+            }
+
+            void Pin()
+            {
+                Record* record = this->Local();
+                if (record->nesting++ == 0)
+                {
+                    record->state.exchange((this->epoch.load() << 1) | active_bit);
+                }
+            }
+
+            void Unpin()
+            {
+                Record* record = this->Local();
+                if (--record->nesting == 0)
+                {
+                    record->state.store(0, std::memory_order_release);
+                }
+            }
+
+            // The pointer must already be unreachable for threads that pin after this call.
+            void Retire(void* pointer, void (*deleter)(void*))
+            {
+                Record* record = this->Local();
+                Retired retired = {pointer, deleter, this->epoch.load()};
+                record->retired.push_back(retired);
+                if (++record->since_collect >= collect_interval)
+                {
+                    // Nothing more becomes safe to free until the epoch moves, and a thread pinned for a long operation
+                    // (such as a Clear) holds it back. Walking the list only once per epoch keeps retiring linear.
+                    record->since_collect = 0;
+                    if (this->TryAdvance() || this->epoch.load() != record->collected)
+                    {
+                        this->Collect(record);
+                    }
+                }
+            }
+
+            // Frees whatever the calling thread retired and is already safe to free. Only useful to bound memory on
+            // threads that retire rarely, or in tests.
+            void Collect()
+            {
+                this->Collect(this->Local());
+            }
+    };
+
+    class EpochGuard
+    {
+        public:
+            EpochGuard()
+            {
+                EpochDomain::Get().Pin();
+            }
+
+            EpochGuard(const EpochGuard&)
+            {
+                EpochDomain::Get().Pin();
+            }
+
+            EpochGuard& operator=(const EpochGuard&)
+            {
+                return *this;
+            }
+
+            ~EpochGuard()
+            {
+                EpochDomain::Get().Unpin();
+            }
+    };
+
+    // Node links are split reference counted jss::markable_atomic_shared_ptr. Every traversal hop takes and drops a
+    // counted reference, nodes are freed when the last reference goes away. This is the default. A node, its trailing
+    // links and its reference count header share one block from the allocator.
+    struct SharedReclamation
+    {
+        template <typename N>
+        struct Pointers
+        {
+            typedef jss::shared_ptr<N> SPtr;
+            typedef jss::markable_atomic_shared_ptr<N> MASPtr;
+        };
+
+        struct NodeBase
+        {
+            explicit NodeBase(int)
+            {
+            }
+
+            bool ReleaseLink()
+            {
+                return false;
+            }
+        };
+
+        class Guard
+        {
+            public:
+                Guard()
+                {
+                }
+        };
+
+        // size is the number of bytes the node needs, N::Size(level)
+        template <typename N, typename A, typename... Args>
+        static jss::shared_ptr<N> Make(size_t size, Args&&... args)
+        {
+            return jss::allocate_shared_trailing<N>(A(), size, std::forward<Args>(args)...);
+        }
+
+        template <typename A, typename N>
+        static void Unlinked(const jss::shared_ptr<N>&)
+        {
+        }
+
+        // Handles keep nodes alive by the reference they hold
+        template <typename A, typename N>
+        static void Hold(const jss::shared_ptr<N>&)
+        {
+        }
+
+        // Publishes a node as a hint, such as the last node of a level. The hint holds a reference of its own.
+        template <typename A, typename N>
+        static void Publish(jss::markable_atomic_shared_ptr<N>& hint, const jss::shared_ptr<N>& node)
+        {
+            hint.store(node);
+        }
+
+        template <typename A, typename N>
+        static void Drop(jss::markable_atomic_shared_ptr<N>& hint)
+        {
+            hint.store(jss::shared_ptr<N>());
+        }
+
+        template <typename A, typename N>
+        static void Destroy(jss::shared_ptr<N>&, int)
+        {
+        }
+    };
+
+    // Node links are raw marked pointers and loads are plain acquire loads. A node counts the levels it is still
+    // linked at, the thread that snips its last link retires it to the EpochDomain.
+    struct EpochReclamation
+    {
+        template <typename N>
+        struct Pointers
+        {
+            typedef N* SPtr;
+            typedef MarkableAtomicPtr<N> MASPtr;
+        };
+
+        struct NodeBase
+        {
+            std::atomic<int> links;
+
+            explicit NodeBase(int level) : links(level)
+            {
+            }
+
+            bool ReleaseLink()
+            {
+                return this->links.fetch_sub(1) == 1;
+            }
+
+            void HoldLink()
+            {
+                this->links++;
+            }
+
+            // Fails once the node was unlinked everywhere, it may be retired already
+            bool TryHoldLink()
+            {
+                int current = this->links.load();
+                while (current > 0 && !this->links.compare_exchange_weak(current, current + 1))
+                {
+                }
+                return current > 0;
+            }
+        };
+
+        typedef EpochGuard Guard;
+
+        // Nodes are allocated in 16 byte units, enough for their trailing links
+        typedef std::aligned_storage<16, 16>::type Unit;
+
+        static size_t Units(size_t size)
+        {
+            return (size + sizeof(Unit) - 1) / sizeof(Unit);
+        }
+
+        // size is the number of bytes the node needs, N::Size(level)
+        template <typename N, typename A, typename... Args>
+        static N* Make(size_t size, Args&&... args)
+        {
+            typename std::allocator_traits<A>::template rebind_alloc<Unit> allocator;
+            Unit* block = allocator.allocate(Units(size));
+            try
+            {
+                return new (block) N(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                allocator.deallocate(block, Units(size));
+                throw;
+            }
+        }
+
+        template <typename N, typename A>
+        static void Delete(void* pointer)
+        {
+            typename std::allocator_traits<A>::template rebind_alloc<Unit> allocator;
+            N* node = static_cast<N*>(pointer);
+            size_t units = Units(N::Size(node->GetLevel()));
+            node->~N();
+            allocator.deallocate(static_cast<Unit*>(pointer), units);
+        }
+
+        template <typename A, typename N>
+        static void Unlinked(N* node)
+        {
+            if (node->ReleaseLink())
+            {
+                EpochDomain::Get().Retire(node, &EpochReclamation::Delete<N, A>);
+            }
+        }
+
+        // Counts a handle as one more link, so the node outlives its links until Unlinked is called for the handle
+        // too. Must be called before the node is linked.
+        template <typename A, typename N>
+        static void Hold(N* node)
+        {
+            node->HoldLink();
+        }
+
+        // Publishes a node as a hint, such as the last node of a level. Like a handle the hint counts as a link, so the
+        // node stays allocated until the hint moves on, but a node that was unlinked everywhere already is not
+        // published. The caller must be pinned.
+        template <typename A, typename N>
+        static void Publish(MarkableAtomicPtr<N>& hint, N* node)
+        {
+            if (!node->TryHoldLink())
+            {
+                return;
+            }
+            N* old = hint.exchange(node);
+            if (old)
+            {
+                Unlinked<A>(old);
+            }
+        }
+
+        template <typename A, typename N>
+        static void Drop(MarkableAtomicPtr<N>& hint)
+        {
+            N* old = hint.exchange(nullptr);
+            if (old)
+            {
+                Unlinked<A>(old);
+            }
+        }
+
+        // Single threaded teardown. Walks levels top down and frees a node at the lowest level it is still linked
+        // at, nodes already unlinked everywhere were retired and are freed by the domain.
+        template <typename A, typename N>
+        static void Destroy(N*& head, int levels)
+        {
+            if (!head)
+            {
+                return;
+            }
+            for (int level = levels - 1; level >= 0; --level)
+            {
+                N* node = head->GetNextPointer(level);
+                while (node)
+                {
+                    N* next = node->GetNextPointer(level);
+                    if (node->ReleaseLink())
+                    {
+                        Delete<N, A>(node);
+                    }
+                    node = next;
+                }
+            }
+            Delete<N, A>(head);
+            head = nullptr;
+        }
+    };
+}
+
+#endif // __CSLPQ_RECLAMATION_HPP__
@@ -0,0 +1,500 @@
+#ifndef __CSLPQ_SHARDED_HPP__
+#define __CSLPQ_SHARDED_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include "Numa.hpp"
+#include "Queue.hpp"
+#include "Random.hpp"
+
+namespace CSLPQ
+{
+    // Every shard in one group, threads push to and pop from any shard. This is the default.
+    struct FlatAffinity
+    {
+        static uint32_t Groups()
+        {
+            return 1;
+        }
+
+        static uint32_t Group()
+        {
+            return 0;
+        }
+    };
+
+    // A group of shards per NUMA node. Threads push to shards of their node, so with PoolAllocator node memory is
+    // carved from slabs of that node, and pop from shards of other nodes only once those of their own are empty.
+    struct NumaAffinity
+    {
+        static uint32_t Groups()
+        {
+            return NumaTopology::Nodes();
+        }
+
+        static uint32_t Group()
+        {
+            return NumaTopology::CurrentNode();
+        }
+    };
+
+    // S independent queues behind one interface, so that pushes and pops spread over S heads instead of all CASing the
+    // first links of one. Shards are split into the groups of the affinity A, every thread pushes to a home shard of
+    // its group. Pops peek at two random shards of the group and pop the smaller minimum, so a pop returns one of the
+    // smallest elements across shards but not necessarily the smallest. TryPopStrict compares every shard for when
+    // order matters, like draining at shutdown.
+    template <typename K, uint32_t S = 8, typename Q = Queue<K>, typename A = FlatAffinity>
+    class ShardedQueue
+    {
+        static_assert(S > 0, "There must be at least one shard");
+        private:
+            typedef typename Q::Compare Compare;
+
+            // Padded on both sides and between, so that heads and counts of neighbouring shards don't share a cache
+            // line and counting a pop doesn't invalidate the line the queue ends on
+            struct Shard
+            {
+                char padding_before[64];
+                Q queue;
+                char padding_middle[64];
+                // Pops served to threads of the group of the shard
+                std::atomic<uint64_t> hits;
+
+                Shard() : hits(0)
+                {
+                }
+            };
+
+            // Pops by threads of a group from shards of other groups, rare enough to share a line per group
+            struct Steals
+            {
+                char padding_before[64];
+                std::atomic<uint64_t> count;
+
+                Steals() : count(0)
+                {
+                }
+            };
+
+            Shard shards[S];
+            Steals steals[S];
+            const uint32_t groups;
+            char padding_after[64];
+
+            // Threads are numbered round robin as they first use a sharded queue
+            static uint32_t Thread()
+            {
+                static std::atomic<uint32_t> next(0);
+                static thread_local uint32_t index = next++;
+                return index;
+            }
+
+            uint32_t Group() const
+            {
+                return A::Group() % this->groups;
+            }
+
+            // Counts are relaxed and hits sit on a line of their own, so counting every pop stays cheap
+            void Hit(uint32_t shard)
+            {
+                this->shards[shard].hits.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void Steal(uint32_t group)
+            {
+                this->steals[group].count.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Shards are dealt to groups round robin, shard i belongs to group i % groups
+            uint32_t GroupSize(uint32_t group) const
+            {
+                return (S - group + this->groups - 1) / this->groups;
+            }
+
+            uint32_t ShardOf(uint32_t group, uint32_t index) const
+            {
+                return group + this->groups * index;
+            }
+
+            uint32_t Home() const
+            {
+                uint32_t group = this->Group();
+                return this->ShardOf(group, Thread() % this->GroupSize(group));
+            }
+
+            // The shard popped from, -1 if every shard of the group looked empty. Lost races move on to the next shard.
+            int TryPopGroup(K& priority, uint32_t group)
+            {
+                uint32_t size = this->GroupSize(group);
+                for (uint32_t i = 0; i < size; ++i)
+                {
+                    uint32_t shard = this->ShardOf(group, (Thread() + i) % size);
+                    if (this->shards[shard].queue.TryPopStrong(priority))
+                    {
+                        return shard;
+                    }
+                }
+                return -1;
+            }
+
+        public:
+            ShardedQueue() : groups(A::Groups() < 1 ? 1 : (A::Groups() < S ? A::Groups() : S))
+            {
+            }
+
+            ShardedQueue(const ShardedQueue&) = delete;
+            ShardedQueue& operator=(const ShardedQueue&) = delete;
+
+            void Push(const K& priority)
+            {
+                this->shards[this->Home()].queue.Push(priority);
+            }
+
+            // Pushes the whole range to the home shard, so it keeps the batching of Queue::PushBulk
+            template <typename It>
+            void PushBulk(It first, It last)
+            {
+                this->shards[this->Home()].queue.PushBulk(first, last);
+            }
+
+            // Pops the smaller minimum of two random shards of the group of the thread, falls back to the other shards
+            // of the group if both were empty or the element was taken, and steals from other groups only once the
+            // whole group is empty. Fails only if every shard looked empty.
+            bool TryPop(K& priority)
+            {
+                uint32_t group = this->Group();
+                uint32_t size = this->GroupSize(group);
+                uint32_t first = this->ShardOf(group, ThreadRandom::Get().Next(size));
+                uint32_t second = this->ShardOf(group, ThreadRandom::Get().Next(size));
+                K first_least = K();
+                K second_least = K();
+                bool first_found = this->shards[first].queue.TryPeek(first_least);
+                bool second_found = this->shards[second].queue.TryPeek(second_least);
+                if (first_found || second_found)
+                {
+                    bool first_smaller = first_found && (!second_found || !Compare()(second_least, first_least));
+                    uint32_t chosen = first_smaller ? first : second;
+                    if (this->shards[chosen].queue.TryPopStrong(priority))
+                    {
+                        this->Hit(chosen);
+                        return true;
+                    }
+                }
+                int shard = this->TryPopGroup(priority, group);
+                if (shard >= 0)
+                {
+                    this->Hit(shard);
+                    return true;
+                }
+                for (uint32_t i = 1; i < this->groups; ++i)
+                {
+                    if (this->TryPopGroup(priority, (group + i) % this->groups) >= 0)
+                    {
+                        this->Steal(group);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Pops from the shard with the smallest minimum, so once pushes stopped elements come out in order
+            bool TryPopStrict(K& priority)
+            {
+                while (true)
+                {
+                    bool found = false;
+                    uint32_t chosen = 0;
+                    K least = K();
+                    for (uint32_t i = 0; i < S; ++i)
+                    {
+                        K key = K();
+                        if (this->shards[i].queue.TryPeek(key) && (!found || Compare()(key, least)))
+                        {
+                            found = true;
+                            chosen = i;
+                            least = key;
+                        }
+                    }
+                    if (!found)
+                    {
+                        return false;
+                    }
+                    if (this->shards[chosen].queue.TryPopStrong(priority))
+                    {
+                        return true;
+                    }
+                }
+            }
+
+            uint64_t GetSize() const
+            {
+                uint64_t size = 0;
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    size += this->shards[i].queue.GetSize();
+                }
+                return size;
+            }
+
+            // Groups of shards, the NUMA nodes for NumaAffinity
+            uint32_t GetGroups() const
+            {
+                return this->groups;
+            }
+
+            // Pops threads of the group served from shards of their own group
+            uint64_t GetHits(uint32_t group) const
+            {
+                uint64_t hits = 0;
+                for (uint32_t i = 0; i < this->GroupSize(group); ++i)
+                {
+                    hits += this->shards[this->ShardOf(group, i)].hits.load(std::memory_order_relaxed);
+                }
+                return hits;
+            }
+
+            // Pops threads of the group served from shards of other groups
+            uint64_t GetSteals(uint32_t group) const
+            {
+                return this->steals[group].count.load(std::memory_order_relaxed);
+            }
+    };
+
+    // Laid out like ShardedQueue, over KVQueue shards
+    template <typename K, typename V, uint32_t S = 8, typename Q = KVQueue<K, V>, typename A = FlatAffinity>
+    class KVShardedQueue
+    {
+        static_assert(S > 0, "There must be at least one shard");
+        private:
+            typedef typename Q::Compare Compare;
+
+            // Padded on both sides and between, so that heads and counts of neighbouring shards don't share a cache
+            // line and counting a pop doesn't invalidate the line the queue ends on
+            struct Shard
+            {
+                char padding_before[64];
+                Q queue;
+                char padding_middle[64];
+                // Pops served to threads of the group of the shard
+                std::atomic<uint64_t> hits;
+
+                Shard() : hits(0)
+                {
+                }
+            };
+
+            // Pops by threads of a group from shards of other groups, rare enough to share a line per group
+            struct Steals
+            {
+                char padding_before[64];
+                std::atomic<uint64_t> count;
+
+                Steals() : count(0)
+                {
+                }
+            };
+
+            Shard shards[S];
+            Steals steals[S];
+            const uint32_t groups;
+            char padding_after[64];
+
+            // Threads are numbered round robin as they first use a sharded queue
+            static uint32_t Thread()
+            {
+                static std::atomic<uint32_t> next(0);
+                static thread_local uint32_t index = next++;
+                return index;
+            }
+
+            uint32_t Group() const
+            {
+                return A::Group() % this->groups;
+            }
+
+            // Counts are relaxed and hits sit on a line of their own, so counting every pop stays cheap
+            void Hit(uint32_t shard)
+            {
+                this->shards[shard].hits.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void Steal(uint32_t group)
+            {
+                this->steals[group].count.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Shards are dealt to groups round robin, shard i belongs to group i % groups
+            uint32_t GroupSize(uint32_t group) const
+            {
+                return (S - group + this->groups - 1) / this->groups;
+            }
+
+            uint32_t ShardOf(uint32_t group, uint32_t index) const
+            {
+                return group + this->groups * index;
+            }
+
+            uint32_t Home() const
+            {
+                uint32_t group = this->Group();
+                return this->ShardOf(group, Thread() % this->GroupSize(group));
+            }
+
+            // The shard popped from, -1 if every shard of the group looked empty. Lost races move on to the next shard.
+            int TryPopGroup(K& priority, V& data, uint32_t group)
+            {
+                uint32_t size = this->GroupSize(group);
+                for (uint32_t i = 0; i < size; ++i)
+                {
+                    uint32_t shard = this->ShardOf(group, (Thread() + i) % size);
+                    if (this->shards[shard].queue.TryPopStrong(priority, data))
+                    {
+                        return shard;
+                    }
+                }
+                return -1;
+            }
+
+        public:
+            KVShardedQueue() : groups(A::Groups() < 1 ? 1 : (A::Groups() < S ? A::Groups() : S))
+            {
+            }
+
+            KVShardedQueue(const KVShardedQueue&) = delete;
+            KVShardedQueue& operator=(const KVShardedQueue&) = delete;
+
+            void Push(const K& priority)
+            {
+                this->shards[this->Home()].queue.Push(priority);
+            }
+
+            void Push(const K& priority, const V& data)
+            {
+                this->shards[this->Home()].queue.Push(priority, data);
+            }
+
+            void Push(const K& priority, V&& data)
+            {
+                this->shards[this->Home()].queue.Push(priority, std::move(data));
+            }
+
+            template <typename... Args>
+            void Emplace(const K& priority, Args&&... args)
+            {
+                this->shards[this->Home()].queue.Emplace(priority, std::forward<Args>(args)...);
+            }
+
+            // Pushes the whole range to the home shard, so it keeps the batching of KVQueue::PushBulk
+            template <typename It>
+            void PushBulk(It first, It last)
+            {
+                this->shards[this->Home()].queue.PushBulk(first, last);
+            }
+
+            // Pops the smaller minimum of two random shards of the group of the thread, falls back to the other shards
+            // of the group if both were empty or the element was taken, and steals from other groups only once the
+            // whole group is empty. Fails only if every shard looked empty.
+            bool TryPop(K& priority, V& data)
+            {
+                uint32_t group = this->Group();
+                uint32_t size = this->GroupSize(group);
+                uint32_t first = this->ShardOf(group, ThreadRandom::Get().Next(size));
+                uint32_t second = this->ShardOf(group, ThreadRandom::Get().Next(size));
+                K first_least = K();
+                K second_least = K();
+                bool first_found = this->shards[first].queue.TryPeek(first_least);
+                bool second_found = this->shards[second].queue.TryPeek(second_least);
+                if (first_found || second_found)
+                {
+                    bool first_smaller = first_found && (!second_found || !Compare()(second_least, first_least));
+                    uint32_t chosen = first_smaller ? first : second;
+                    if (this->shards[chosen].queue.TryPopStrong(priority, data))
+                    {
+                        this->Hit(chosen);
+                        return true;
+                    }
+                }
+                int shard = this->TryPopGroup(priority, data, group);
+                if (shard >= 0)
+                {
+                    this->Hit(shard);
+                    return true;
+                }
+                for (uint32_t i = 1; i < this->groups; ++i)
+                {
+                    if (this->TryPopGroup(priority, data, (group + i) % this->groups) >= 0)
+                    {
+                        this->Steal(group);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Pops from the shard with the smallest minimum, so once pushes stopped elements come out in order
+            bool TryPopStrict(K& priority, V& data)
+            {
+                while (true)
+                {
+                    bool found = false;
+                    uint32_t chosen = 0;
+                    K least = K();
+                    for (uint32_t i = 0; i < S; ++i)
+                    {
+                        K key = K();
+                        if (this->shards[i].queue.TryPeek(key) && (!found || Compare()(key, least)))
+                        {
+                            found = true;
+                            chosen = i;
+                            least = key;
+                        }
+                    }
+                    if (!found)
+                    {
+                        return false;
+                    }
+                    if (this->shards[chosen].queue.TryPopStrong(priority, data))
+                    {
+                        return true;
+                    }
+                }
+            }
+
+            uint64_t GetSize() const
+            {
+                uint64_t size = 0;
+                for (uint32_t i = 0; i < S; ++i)
+                {
+                    size += this->shards[i].queue.GetSize();
+                }
+                return size;
+            }
+
+            // Groups of shards, the NUMA nodes for NumaAffinity
+            uint32_t GetGroups() const
+            {
+                return this->groups;
+            }
+
+            // Pops threads of the group served from shards of their own group
+            uint64_t GetHits(uint32_t group) const
+            {
+                uint64_t hits = 0;
+                for (uint32_t i = 0; i < this->GroupSize(group); ++i)
+                {
+                    hits += this->shards[this->ShardOf(group, i)].hits.load(std::memory_order_relaxed);
+                }
+                return hits;
+            }
+
+            // Pops threads of the group served from shards of other groups
+            uint64_t GetSteals(uint32_t group) const
+            {
+                return this->steals[group].count.load(std::memory_order_relaxed);
+            }
+    };
+}
+
+#endif // __CSLPQ_SHARDED_HPP__
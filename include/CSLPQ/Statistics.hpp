@@ -0,0 +1,172 @@
+#ifndef __CSLPQ_STATISTICS_HPP__
+#define __CSLPQ_STATISTICS_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Counters.hpp"
+
+namespace CSLPQ
+{
+    // Contention events a queue counts when its traits enable statistics
+    struct Event
+    {
+        enum Type
+        {
+            // A push lost the CAS linking its node at the bottom level and searched again
+            LinkRetry,
+            // A push lost the CAS linking its node at a level above the bottom one and searched again
+            LevelRetry,
+            // A search for a key lost a snip and restarted from the head
+            SearchRetry,
+            // A search for the first node lost a snip and restarted from the head
+            FirstRetry,
+            // A run of marked nodes was unlinked at one level
+            Snip,
+            // A pop found a node still being inserted, TryPop gives up on it and the other pops skip it
+            Inserting,
+            // A pop lost the mark of a node to another pop or an erase
+            LostMark,
+            Count
+        };
+    };
+
+    // A snapshot of the statistics of a queue, summed over threads without stopping them
+    struct QueueStats
+    {
+        uint64_t events[Event::Count];
+        // Per level, how many times a search ran through the level and how many links it followed there in total
+        std::vector<uint64_t> searches;
+        std::vector<uint64_t> steps;
+
+        QueueStats() : events(), searches(), steps()
+        {
+        }
+
+        uint64_t Get(Event::Type event) const
+        {
+            return this->events[event];
+        }
+
+        // Links followed per search at a level, 0 if no search ran through it
+        double AverageSteps(uint32_t level) const
+        {
+            if (level >= this->searches.size() || !this->searches[level])
+            {
+                return 0;
+            }
+            return static_cast<double>(this->steps[level]) / this->searches[level];
+        }
+    };
+
+    // Nothing is counted and every hook compiles away. This is the default.
+    struct NoStatistics
+    {
+        template <int Levels>
+        class Counters
+        {
+            public:
+                static const bool enabled = false;
+
+                void Count(Event::Type)
+                {
+                }
+
+                void Traversed(int, uint64_t)
+                {
+                }
+
+                QueueStats Get() const
+                {
+                    return QueueStats();
+                }
+        };
+    };
+
+    // Counts events and search steps per level in S stripes on cache lines of their own, each thread adds to the
+    // stripe of its index like StripedCounter does. Counts are relaxed, they only need to add up once threads stop.
+    template <uint32_t S = 16>
+    struct ContentionStatistics
+    {
+        static_assert(S > 0, "There must be at least one stripe");
+
+        template <int Levels>
+        class Counters
+        {
+            private:
+                struct Stripe
+                {
+                    char padding_before[64];
+                    std::atomic<uint64_t> events[Event::Count];
+                    std::atomic<uint64_t> searches[Levels];
+                    std::atomic<uint64_t> steps[Levels];
+                };
+
+                Stripe stripes[S];
+                char padding_after[64];
+
+                Stripe& Local()
+                {
+                    return this->stripes[StripeIndex() % S];
+                }
+
+            public:
+                static const bool enabled = true;
+
+                Counters()
+                {
+                    for (uint32_t i = 0; i < S; ++i)
+                    {
+                        for (int event = 0; event < Event::Count; ++event)
+                        {
+                            this->stripes[i].events[event].store(0, std::memory_order_relaxed);
+                        }
+                        for (int level = 0; level < Levels; ++level)
+                        {
+                            this->stripes[i].searches[level].store(0, std::memory_order_relaxed);
+                            this->stripes[i].steps[level].store(0, std::memory_order_relaxed);
+                        }
+                    }
+                }
+
+                Counters(const Counters&) = delete;
+                Counters& operator=(const Counters&) = delete;
+
+                void Count(Event::Type event)
+                {
+                    this->Local().events[event].fetch_add(1, std::memory_order_relaxed);
+                }
+
+                // A search ran through level following steps links
+                void Traversed(int level, uint64_t steps)
+                {
+                    Stripe& stripe = this->Local();
+                    stripe.searches[level].fetch_add(1, std::memory_order_relaxed);
+                    stripe.steps[level].fetch_add(steps, std::memory_order_relaxed);
+                }
+
+                QueueStats Get() const
+                {
+                    QueueStats stats;
+                    stats.searches.assign(Levels, 0);
+                    stats.steps.assign(Levels, 0);
+                    for (uint32_t i = 0; i < S; ++i)
+                    {
+                        for (int event = 0; event < Event::Count; ++event)
+                        {
+                            stats.events[event] += this->stripes[i].events[event].load(std::memory_order_relaxed);
+                        }
+                        for (int level = 0; level < Levels; ++level)
+                        {
+                            stats.searches[level] += this->stripes[i].searches[level].load(std::memory_order_relaxed);
+                            stats.steps[level] += this->stripes[i].steps[level].load(std::memory_order_relaxed);
+                        }
+                    }
+                    return stats;
+                }
+        };
+    };
+}
+
+#endif // __CSLPQ_STATISTICS_HPP__
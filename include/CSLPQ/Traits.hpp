@@ -0,0 +1,49 @@
+#ifndef __CSLPQ_TRAITS_HPP__
+#define __CSLPQ_TRAITS_HPP__
+
+#include <functional>
+#include <memory>
+
+#include "Allocator.hpp"
+#include "Buckets.hpp"
+#include "Counters.hpp"
+#include "Deletion.hpp"
+#include "Random.hpp"
+#include "Reclamation.hpp"
+
+namespace CSLPQ
+{
+    // Compile time policies of a queue. To change any of them, derive from DefaultTraits and shadow the typedef, e.g.
+    //     struct MyTraits : CSLPQ::DefaultTraits<uint64_t> { typedef CSLPQ::GeometricLevel<4> LevelGenerator; };
+    //     CSLPQ::Queue<uint64_t, 4, MyTraits> queue;
+    template <typename K>
+    struct DefaultTraits
+    {
+        // Distribution of node levels, must provide static uint32_t Generate(uint32_t max_level) returning a level in
+        // [1, max_level].
+        typedef GeometricLevel<2> LevelGenerator;
+        // How node links are loaded and nodes freed, SharedReclamation (split reference counted links) or
+        // EpochReclamation (raw marked links with epoch based reclamation).
+        typedef SharedReclamation Reclamation;
+        // Where nodes come from, rebound to the node (and reference count header) type. Must be stateless,
+        // PoolAllocator<K> keeps freed nodes in per thread pools instead of returning them to the global heap.
+        typedef std::allocator<K> Allocator;
+        // Elements with equal keys, NoBuckets (a node each) or TieBuckets<C> (up to C ties share the node of the first
+        // one, pushing and popping them skips linking and unlinking towers).
+        typedef NoBuckets Ties;
+        // Element count, ExactCounter (one atomic all threads update) or StripedCounter<S> (S cache padded stripes
+        // summed on read, the count and the max_size bound become approximate).
+        typedef ExactCounter Counter;
+        // Contention counters behind GetStats, NoStatistics (nothing is counted and the hooks compile away) or
+        // ContentionStatistics<S> (events and search steps per level in S cache padded stripes).
+        typedef NoStatistics Statistics;
+        // When popped nodes are unlinked, EagerDeletion (by the next pop) or LazyDeletion<B> (by the pop that finds
+        // more than B of them in front of the first live node).
+        typedef EagerDeletion Deletion;
+        // Order of the keys, a stateless strict weak ordering that pops come out of first. std::less<K> makes a min
+        // queue, std::greater<K> a max queue. Equal keys are the ones neither orders before the other.
+        typedef std::less<K> Compare;
+    };
+}
+
+#endif // __CSLPQ_TRAITS_HPP__
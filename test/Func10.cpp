@@ -0,0 +1,243 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <type_traits>
+
+#include "CSLPQ/Calendar.hpp"
+
+#define COUNT 5000
+#define WINDOW 64
+
+static_assert(std::is_same<CSLPQ::QueueFor<uint32_t>::Type, CSLPQ::CalendarQueue<uint32_t>>::value,
+              "Unsigned keys must pick the calendar");
+static_assert(std::is_same<CSLPQ::KVQueueFor<int, int>::Type, CSLPQ::KVQueue<int, int>>::value,
+              "Signed keys must pick the skiplist");
+
+std::atomic<int64_t> live(0);
+
+struct Tracked
+{
+    uint64_t value;
+
+    Tracked() : value(0)
+    {
+        live++;
+    }
+
+    Tracked(uint64_t value) : value(value)
+    {
+        live++;
+    }
+
+    Tracked(const Tracked& other) : value(other.value)
+    {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+
+    ~Tracked()
+    {
+        live--;
+    }
+};
+
+std::atomic<int64_t> segments(0);
+
+// Counts the slot segments buckets allocate
+template <typename T>
+struct CountingAllocator : std::allocator<T>
+{
+    template <typename U>
+    struct rebind
+    {
+        typedef CountingAllocator<U> other;
+    };
+
+    CountingAllocator()
+    {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        segments++;
+        return std::allocator<T>::allocate(n);
+    }
+};
+
+// Timestamps drifting forward with jitter, a few far in the future, a few in the past and bursts of ties larger than
+// a bucket. i is unique per element, the key is a function of it.
+uint64_t KeyOf(uint64_t i)
+{
+    uint64_t base = 1000000 + i / 4;
+    switch (i % 17)
+    {
+        case 0:
+            return base + 10 * WINDOW;
+        case 1:
+            return base > 3 * WINDOW ? base - 3 * WINDOW : 0;
+        case 2:
+        case 3:
+            return base - base % 16;
+        default:
+            return base + (i * 7919) % 40;
+    }
+}
+
+bool Keys()
+{
+    CSLPQ::CalendarQueue<uint64_t, WINDOW, 8> queue;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.push_back(KeyOf(i));
+    }
+    // Interleave pops with the pushes so the cursor moves while near keys keep arriving
+    std::vector<uint64_t> pending;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(keys[i]);
+        pending.push_back(keys[i]);
+        if (i % 3 == 0)
+        {
+            uint64_t key = 0;
+            std::vector<uint64_t>::iterator least = std::min_element(pending.begin(), pending.end());
+            if (!queue.TryPop(key) || key != *least)
+            {
+                std::cerr << "FAILURE: Read " << key << " expected " << *least << std::endl;
+                return false;
+            }
+            pending.erase(least);
+        }
+    }
+    if (queue.GetSize() != pending.size())
+    {
+        std::cerr << "FAILURE: Size " << queue.GetSize() << " expected " << pending.size() << std::endl;
+        return false;
+    }
+    std::sort(pending.begin(), pending.end());
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPop(key) || key != pending[i])
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << pending[i] << std::endl;
+            return false;
+        }
+    }
+    uint64_t key = 0;
+    if (queue.TryPop(key) || queue.GetSize())
+    {
+        std::cerr << "FAILURE: Read " << key << " from empty queue" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Values()
+{
+    {
+        CSLPQ::KVCalendarQueue<uint64_t, Tracked, WINDOW, 8> queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(KeyOf(i), Tracked(i));
+        }
+        std::vector<bool> seen(COUNT, false);
+        uint64_t last = 0;
+        for (uint64_t i = 0; i < COUNT / 2; i++)
+        {
+            uint64_t key = 0;
+            Tracked value;
+            if (!queue.TryPop(key, value) || key < last || value.value >= COUNT || KeyOf(value.value) != key ||
+                seen[value.value])
+            {
+                std::cerr << "FAILURE: Read " << key << ": " << value.value << " after " << last << std::endl;
+                return false;
+            }
+            seen[value.value] = true;
+            last = key;
+        }
+        // Half is left in the ring and the skiplist, destroyed with the queue
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        CSLPQ::EpochDomain::Get().Collect();
+    }
+    if (live.load() != 0)
+    {
+        std::cerr << "FAILURE: " << live.load() << " values leaked" << std::endl;
+        return false;
+    }
+
+    // Move only values
+    CSLPQ::KVCalendarQueue<uint32_t, std::unique_ptr<std::string>> unique;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        unique.Emplace(i / 10, new std::string(std::to_string(i)));
+    }
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        uint32_t key = 0;
+        std::unique_ptr<std::string> value;
+        if (!unique.TryPop(key, value) || !value || std::stoul(*value) / 10 != key || key != i / 10)
+        {
+            std::cerr << "FAILURE: Read a wrong move only value" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Ring buckets keep their first element inline, only a second one allocates the other slots
+bool Buckets()
+{
+    CSLPQ::TieBuckets<4>::Bucket<uint64_t, CountingAllocator<uint64_t>, 1> bucket;
+    if (!bucket.TryPush(0) || segments.load() != 0 || bucket.Next(0) != 0)
+    {
+        std::cerr << "FAILURE: A single element allocated " << segments.load() << " segments" << std::endl;
+        return false;
+    }
+    for (uint64_t i = 1; i < 4; i++)
+    {
+        bucket.TryPush(i);
+    }
+    if (bucket.TryPush(4) || segments.load() != 1)
+    {
+        std::cerr << "FAILURE: Four elements allocated " << segments.load() << " segments" << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < 4; i++)
+    {
+        int slot = bucket.TryPop();
+        if (slot < 0 || *bucket.Get(slot) != i)
+        {
+            std::cerr << "FAILURE: Popped slot " << slot << " expected " << i << std::endl;
+            return false;
+        }
+    }
+    if (bucket.TryPop() >= 0 || !bucket.Close())
+    {
+        std::cerr << "FAILURE: Popped from a drained bucket" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!Buckets() || !Keys() || !Values())
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "CSLPQ/Sharded.hpp"
+
+#define COUNT 1000
+
+// Stands in for two NUMA nodes, threads say which one they run on
+thread_local uint32_t node = 0;
+
+struct TwoNodes
+{
+    static uint32_t Groups()
+    {
+        return 2;
+    }
+
+    static uint32_t Group()
+    {
+        return node;
+    }
+};
+
+typedef CSLPQ::KVShardedQueue<uint64_t, uint64_t, 4, CSLPQ::KVQueue<uint64_t, uint64_t>, TwoNodes> Sharded;
+
+// Pushes count elements from a thread on the given node
+void Fill(Sharded& queue, uint32_t on, uint64_t count)
+{
+    std::thread([&queue, on, count]()
+    {
+        node = on;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            queue.Push(i, i);
+        }
+    }).join();
+}
+
+// Pops count elements from a thread on the given node
+bool Drain(Sharded& queue, uint32_t on, uint64_t count)
+{
+    bool success = true;
+    std::thread([&queue, on, count, &success]()
+    {
+        node = on;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            success = success && queue.TryPop(key, value) && key == value;
+        }
+    }).join();
+    return success;
+}
+
+int main()
+{
+    Sharded queue;
+    if (queue.GetGroups() != 2)
+    {
+        std::cerr << "FAILURE: " << queue.GetGroups() << " groups expected 2" << std::endl;
+        return 1;
+    }
+
+    // Local elements are preferred, the remote ones are only stolen once the local shards are empty
+    Fill(queue, 0, COUNT);
+    Fill(queue, 1, COUNT / 2);
+    if (!Drain(queue, 1, COUNT) || queue.GetSize() != COUNT / 2)
+    {
+        std::cerr << "FAILURE: Drained the wrong number of elements" << std::endl;
+        return 1;
+    }
+    if (queue.GetHits(1) != COUNT / 2 || queue.GetSteals(1) != COUNT / 2 || queue.GetHits(0) || queue.GetSteals(0))
+    {
+        std::cerr << "FAILURE: Node 1 had " << queue.GetHits(1) << " hits and " << queue.GetSteals(1)
+                  << " steals, node 0 had " << queue.GetHits(0) << " hits and " << queue.GetSteals(0) << " steals"
+                  << std::endl;
+        return 1;
+    }
+    if (!Drain(queue, 0, COUNT / 2) || queue.GetSize() || queue.GetHits(0) != COUNT / 2 || queue.GetSteals(0))
+    {
+        std::cerr << "FAILURE: Node 0 had " << queue.GetHits(0) << " hits and " << queue.GetSteals(0) << " steals"
+                  << std::endl;
+        return 1;
+    }
+
+    // One group per node, as long as there are enough shards
+    CSLPQ::ShardedQueue<uint64_t, 4, CSLPQ::Queue<uint64_t>, CSLPQ::NumaAffinity> numa;
+    uint32_t nodes = CSLPQ::NumaTopology::Nodes();
+    if (numa.GetGroups() != (nodes < 4 ? nodes : 4) || CSLPQ::NumaTopology::CurrentNode() >= nodes)
+    {
+        std::cerr << "FAILURE: " << numa.GetGroups() << " groups for " << CSLPQ::NumaTopology::Nodes() << " nodes"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
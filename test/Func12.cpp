@@ -0,0 +1,194 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 3000
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+struct TieEpochTraits : EpochTraits
+{
+    typedef CSLPQ::TieBuckets<8> Ties;
+};
+
+std::atomic<int64_t> live(0);
+
+struct Tracked
+{
+    uint64_t value;
+
+    Tracked() : value(0)
+    {
+        live++;
+    }
+
+    Tracked(uint64_t value) : value(value)
+    {
+        live++;
+    }
+
+    Tracked(const Tracked& other) : value(other.value)
+    {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+
+    ~Tracked()
+    {
+        live--;
+    }
+};
+
+// Of the elements pushed with handles every third is erased, every third moved to its key plus COUNT and the rest
+// popped as pushed. Their values are their index, those of the elements pushed without handles in between are offset
+// by 2 * COUNT.
+template <typename Q>
+bool run(const char* name)
+{
+    std::vector<typename Q::Handle> kept;
+    {
+        Q queue;
+        std::vector<typename Q::Handle> handles;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(i / 2, Tracked(2 * COUNT + i));
+            handles.push_back(queue.PushWithHandle(i, Tracked(i)));
+        }
+        // Ties pushed without handles go around the nodes of handles
+        for (uint64_t i = 0; i < COUNT; i += 3)
+        {
+            if (!queue.Erase(handles[i]) || queue.Erase(handles[i]))
+            {
+                std::cerr << "FAILURE-" << name << ": Erase " << i << " did not succeed exactly once" << std::endl;
+                return false;
+            }
+            if (queue.UpdatePriority(handles[i], COUNT + i))
+            {
+                std::cerr << "FAILURE-" << name << ": Moved erased element " << i << std::endl;
+                return false;
+            }
+        }
+        for (uint64_t i = 1; i < COUNT; i += 3)
+        {
+            if (!queue.UpdatePriority(handles[i], COUNT + i) || !handles[i].IsValid())
+            {
+                std::cerr << "FAILURE-" << name << ": Could not move " << i << std::endl;
+                return false;
+            }
+        }
+        if (queue.GetSize() != COUNT + COUNT * 2 / 3)
+        {
+            std::cerr << "FAILURE-" << name << ": Size " << queue.GetSize() << " expected " << COUNT + COUNT * 2 / 3
+                      << std::endl;
+            return false;
+        }
+
+        std::vector<std::pair<uint64_t, uint64_t>> expected;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            expected.emplace_back(i / 2, i + 2 * COUNT);
+            if (i % 3 == 2)
+            {
+                expected.emplace_back(i, i);
+            }
+            else if (i % 3 == 1)
+            {
+                expected.emplace_back(COUNT + i, i);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        std::vector<std::pair<uint64_t, uint64_t>> popped;
+        uint64_t key = 0;
+        Tracked value;
+        while (queue.TryPopStrong(key, value))
+        {
+            if (!popped.empty() && key < popped.back().first)
+            {
+                std::cerr << "FAILURE-" << name << ": Read " << key << " after " << popped.back().first << std::endl;
+                return false;
+            }
+            popped.emplace_back(key, value.value);
+        }
+        std::sort(popped.begin(), popped.end());
+        if (popped != expected)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << popped.size() << " elements, not the "
+                      << expected.size() << " expected" << std::endl;
+            return false;
+        }
+
+        // Popped elements can no longer be erased, their handles outlive the queue
+        for (uint64_t i = 2; i < COUNT; i += 3)
+        {
+            if (queue.Erase(handles[i]))
+            {
+                std::cerr << "FAILURE-" << name << ": Erased popped element " << i << std::endl;
+                return false;
+            }
+        }
+        kept.assign(handles.begin(), handles.begin() + COUNT / 2);
+        queue.PushWithHandle(1, Tracked(1));
+        kept.push_back(queue.PushWithHandle(2, Tracked(2)));
+    }
+    kept.clear();
+    for (int i = 0; i < 4; i++)
+    {
+        CSLPQ::EpochDomain::Get().Collect();
+    }
+    if (live.load() != 0)
+    {
+        std::cerr << "FAILURE-" << name << ": " << live.load() << " values leaked" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, Tracked>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, Tracked, 31, EpochTraits>>("Epoch") ||
+        !run<CSLPQ::KVQueue<uint64_t, Tracked, 31, TieEpochTraits>>("Ties"))
+    {
+        return 1;
+    }
+
+    // Keys only, erased and moved keys in order
+    CSLPQ::Queue<uint64_t, 31, EpochTraits> queue;
+    std::vector<CSLPQ::Queue<uint64_t, 31, EpochTraits>::Handle> handles;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        handles.push_back(queue.PushWithHandle(i));
+    }
+    for (uint64_t i = 0; i < COUNT; i += 2)
+    {
+        queue.UpdatePriority(handles[i], COUNT + i);
+        queue.Erase(handles[i + 1]);
+    }
+    for (uint64_t i = 0; i < COUNT; i += 2)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPopStrong(key) || key != COUNT + i)
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << COUNT + i << std::endl;
+            return 1;
+        }
+    }
+    uint64_t key = 0;
+    if (queue.TryPop(key) || queue.GetSize())
+    {
+        std::cerr << "FAILURE: Read " << key << " from empty queue" << std::endl;
+        return 1;
+    }
+    return 0;
+}
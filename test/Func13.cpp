@@ -0,0 +1,174 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 100000
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+struct TieEpochTraits : EpochTraits
+{
+    typedef CSLPQ::TieBuckets<8> Ties;
+};
+
+std::atomic<int64_t> live(0);
+
+struct Tracked
+{
+    uint64_t value;
+
+    Tracked() : value(0)
+    {
+        live++;
+    }
+
+    Tracked(uint64_t value) : value(value)
+    {
+        live++;
+    }
+
+    Tracked(const Tracked& other) : value(other.value)
+    {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+
+    ~Tracked()
+    {
+        live--;
+    }
+};
+
+// Drains half the elements in order, clears the rest, and checks the queue is usable and empty afterwards. Keys are
+// i / 2, so with tie buckets every other element is a tie.
+template <typename Q>
+bool run(const char* name)
+{
+    {
+        Q queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(((i * 7919) % COUNT) / 2, Tracked(i));
+        }
+        std::vector<std::pair<uint64_t, Tracked>> drained;
+        if (queue.TryPopN(std::back_inserter(drained), COUNT / 2) != COUNT / 2)
+        {
+            std::cerr << "FAILURE-" << name << ": Could not pop half the elements" << std::endl;
+            return false;
+        }
+        if (queue.Clear() != COUNT / 2 || queue.GetSize())
+        {
+            std::cerr << "FAILURE-" << name << ": Clear did not remove the other half" << std::endl;
+            return false;
+        }
+        uint64_t key = 0;
+        Tracked value;
+        if (queue.TryPeek(key) || queue.TryPopStrong(key, value) || queue.Clear())
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " from cleared queue" << std::endl;
+            return false;
+        }
+
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(((i * 7919) % COUNT) / 2, Tracked(i));
+        }
+        drained.clear();
+        if (queue.DrainTo(std::back_inserter(drained)) != COUNT || queue.GetSize())
+        {
+            std::cerr << "FAILURE-" << name << ": Drained " << drained.size() << " elements expected " << COUNT
+                      << std::endl;
+            return false;
+        }
+        for (uint64_t i = 1; i < COUNT; i++)
+        {
+            if (drained[i].first < drained[i - 1].first)
+            {
+                std::cerr << "FAILURE-" << name << ": Drained " << drained[i].first << " after "
+                          << drained[i - 1].first << std::endl;
+                return false;
+            }
+        }
+        std::vector<uint64_t> values;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            values.push_back(drained[i].second.value);
+        }
+        std::sort(values.begin(), values.end());
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            if (values[i] != i)
+            {
+                std::cerr << "FAILURE-" << name << ": Value " << i << " missing or drained twice" << std::endl;
+                return false;
+            }
+        }
+
+        // Cleared queues take new elements, and a queue can be destroyed with elements in it
+        queue.Push(5, Tracked(5));
+        queue.Clear();
+        queue.Push(3, Tracked(3));
+        queue.Push(4, Tracked(4));
+        if (!queue.TryPopStrong(key, value) || key != 3 || value.value != 3)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " expected 3 after clear" << std::endl;
+            return false;
+        }
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        CSLPQ::EpochDomain::Get().Collect();
+    }
+    if (live.load() != 0)
+    {
+        std::cerr << "FAILURE-" << name << ": " << live.load() << " values leaked" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, Tracked>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, Tracked, 31, EpochTraits>>("Epoch") ||
+        !run<CSLPQ::KVQueue<uint64_t, Tracked, 31, TieEpochTraits>>("Ties"))
+    {
+        return 1;
+    }
+
+    // Keys only
+    CSLPQ::Queue<uint64_t, 31, EpochTraits> queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(COUNT - i);
+    }
+    std::vector<uint64_t> keys;
+    if (queue.DrainTo(std::back_inserter(keys)) != COUNT || !std::is_sorted(keys.begin(), keys.end()))
+    {
+        std::cerr << "FAILURE: Drained " << keys.size() << " keys out of order" << std::endl;
+        return 1;
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(i);
+    }
+    uint64_t key = 0;
+    if (queue.Clear() != COUNT || queue.TryPop(key) || queue.GetSize())
+    {
+        std::cerr << "FAILURE: Read " << key << " from cleared queue" << std::endl;
+        return 1;
+    }
+    return 0;
+}
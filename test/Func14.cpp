@@ -0,0 +1,111 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define THREADS 4
+
+struct StatsTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::ContentionStatistics<> Statistics;
+};
+
+struct EpochStatsTraits : StatsTraits
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+// Pushes and pops on one thread and checks what must have been counted, then on several threads and checks the
+// counts are still consistent
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push((i * 7919) % COUNT, i);
+    }
+    CSLPQ::QueueStats stats = queue.GetStats();
+    if (stats.Get(CSLPQ::Event::LinkRetry) || stats.Get(CSLPQ::Event::LevelRetry) ||
+        stats.Get(CSLPQ::Event::SearchRetry) || stats.Get(CSLPQ::Event::LostMark))
+    {
+        std::cerr << "FAILURE-" << name << ": Retries counted without contention" << std::endl;
+        return false;
+    }
+    // Pushes of a new smallest or largest key skip the search
+    if (stats.searches.size() != 32 || !stats.searches[0] || stats.AverageSteps(0) <= 0 ||
+        stats.AverageSteps(0) > 16)
+    {
+        std::cerr << "FAILURE-" << name << ": " << stats.AverageSteps(0) << " steps per search at the bottom level"
+                  << std::endl;
+        return false;
+    }
+
+    uint64_t key = 0;
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < COUNT / 2; i++)
+    {
+        queue.TryPop(key, value);
+    }
+    // Every pop but the first unlinks the node popped before it
+    if (queue.GetStats().Get(CSLPQ::Event::Snip) < COUNT / 2 - 1)
+    {
+        std::cerr << "FAILURE-" << name << ": " << queue.GetStats().Get(CSLPQ::Event::Snip) << " snips counted"
+                  << std::endl;
+        return false;
+    }
+
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                queue.Push(i, i);
+                queue.TryPopStrong(key, value);
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+    CSLPQ::QueueStats after = queue.GetStats();
+    for (int event = 0; event < CSLPQ::Event::Count; event++)
+    {
+        if (after.events[event] < stats.events[event])
+        {
+            std::cerr << "FAILURE-" << name << ": Count of event " << event << " went down" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, StatsTraits>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, EpochStatsTraits>>("Epoch"))
+    {
+        return 1;
+    }
+
+    // Without statistics nothing is counted
+    CSLPQ::Queue<uint64_t> queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(i);
+    }
+    CSLPQ::QueueStats stats = queue.GetStats();
+    if (stats.Get(CSLPQ::Event::Snip) || !stats.searches.empty() || stats.AverageSteps(0) != 0)
+    {
+        std::cerr << "FAILURE: Statistics counted without being enabled" << std::endl;
+        return 1;
+    }
+    return 0;
+}
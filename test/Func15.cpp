@@ -0,0 +1,120 @@
+#include <iostream>
+#include <vector>
+#include <iterator>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define THRESHOLD 32
+
+struct EagerTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::ContentionStatistics<> Statistics;
+};
+
+struct LazyTraits : EagerTraits
+{
+    typedef CSLPQ::LazyDeletion<THRESHOLD> Deletion;
+};
+
+struct EpochLazyTraits : LazyTraits
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+// Pops in order through every kind of pop and returns how many snips the pops counted, or 0 on a failure
+template <typename Q>
+uint64_t run(const char* name)
+{
+    Q queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push((i * 7919) % COUNT, i);
+    }
+    uint64_t before = queue.GetStats().Get(CSLPQ::Event::Snip);
+
+    uint64_t expected = 0;
+    uint64_t key = 0;
+    uint64_t value = 0;
+    for (; expected < COUNT / 2; expected++)
+    {
+        if (!queue.TryPop(key, value) || key != expected)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " expected " << expected << std::endl;
+            return 0;
+        }
+    }
+    uint64_t snips = queue.GetStats().Get(CSLPQ::Event::Snip) - before;
+
+    while (expected < COUNT)
+    {
+        uint64_t peeked = 0;
+        if (!queue.TryPeek(peeked) || peeked != expected)
+        {
+            std::cerr << "FAILURE-" << name << ": Peeked " << peeked << " expected " << expected << std::endl;
+            return 0;
+        }
+        if (expected % 2)
+        {
+            if (!queue.TryPopStrong(key, value) || key != expected)
+            {
+                std::cerr << "FAILURE-" << name << ": Read " << key << " expected " << expected << std::endl;
+                return 0;
+            }
+            expected++;
+            continue;
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> pairs;
+        queue.TryPopN(std::back_inserter(pairs), 5);
+        for (size_t i = 0; i < pairs.size(); i++, expected++)
+        {
+            if (pairs[i].first != expected)
+            {
+                std::cerr << "FAILURE-" << name << ": Read " << pairs[i].first << " expected " << expected
+                          << std::endl;
+                return 0;
+            }
+        }
+    }
+    if (queue.TryPop(key, value) || queue.GetSize())
+    {
+        std::cerr << "FAILURE-" << name << ": Queue not empty after popping everything" << std::endl;
+        return 0;
+    }
+
+    // Keys pushed below the marked prefix come out first
+    for (uint64_t i = 0; i < THRESHOLD / 2; i++)
+    {
+        queue.Push(COUNT + i, i);
+    }
+    for (uint64_t i = 0; i < THRESHOLD / 4; i++)
+    {
+        queue.TryPop(key, value);
+    }
+    queue.Push(0, 0);
+    if (!queue.TryPop(key, value) || key != 0)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << key << " expected 0" << std::endl;
+        return 0;
+    }
+    return snips;
+}
+
+int main()
+{
+    uint64_t eager = run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, EagerTraits>>("Eager");
+    uint64_t lazy = run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, LazyTraits>>("Lazy");
+    uint64_t epoch = run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, EpochLazyTraits>>("EpochLazy");
+    if (!eager || !lazy || !epoch)
+    {
+        return 1;
+    }
+    // Eager pops unlink the node before them, lazy ones a prefix about every THRESHOLD pops, a CAS per level of it
+    if (lazy * 4 > eager || epoch * 4 > eager)
+    {
+        std::cerr << "FAILURE: " << lazy << " and " << epoch << " snips with lazy deletion, " << eager << " without"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
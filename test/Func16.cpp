@@ -0,0 +1,219 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define THREADS 3
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+struct TieTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::TieBuckets<8> Ties;
+};
+
+struct TieEpochTraits : EpochTraits
+{
+    typedef CSLPQ::TieBuckets<8> Ties;
+};
+
+// Keys come out in order, ties included, and ranges count what they cover
+template <typename Q>
+bool run_keys(const char* name)
+{
+    Q queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(((i * 7919) % COUNT) / 2);
+    }
+    uint64_t expected = 0;
+    for (uint64_t key : queue)
+    {
+        if (key != expected / 2)
+        {
+            std::cerr << "FAILURE-" << name << ": Iterated " << key << " expected " << expected / 2 << std::endl;
+            return false;
+        }
+        expected++;
+    }
+    if (expected != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Iterated " << expected << " keys expected " << COUNT << std::endl;
+        return false;
+    }
+
+    uint64_t key = 0;
+    for (uint64_t i = 0; i < COUNT / 2 + 1; i++)
+    {
+        queue.TryPop(key);
+    }
+    if (static_cast<uint64_t>(std::distance(queue.begin(), queue.end())) != COUNT / 2 - 1 ||
+        *queue.begin() != COUNT / 4)
+    {
+        std::cerr << "FAILURE-" << name << ": Iterated popped keys" << std::endl;
+        return false;
+    }
+
+    uint64_t last = 0;
+    size_t count = queue.ForEachInRange(COUNT / 4 + 10, COUNT / 4 + 110, [&](uint64_t key)
+    {
+        if (key < COUNT / 4 + 10 || key >= COUNT / 4 + 110 || key < last)
+        {
+            last = COUNT;
+        }
+        else
+        {
+            last = key;
+        }
+    });
+    if (count != 200 || last != COUNT / 4 + 109 || queue.ForEachInRange(COUNT, COUNT * 2, [](uint64_t) {}) ||
+        queue.ForEachInRange(0, COUNT, [](uint64_t) {}) != COUNT / 2 - 1)
+    {
+        std::cerr << "FAILURE-" << name << ": Range visited " << count << " keys up to " << last << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Values are seen with their keys, and an iterator stays in order while other threads push and pop
+template <typename Q>
+bool run_values(const char* name)
+{
+    Q queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(i / 4, i);
+    }
+    std::vector<uint64_t> values;
+    for (auto it = queue.begin(); it != queue.end(); ++it)
+    {
+        if (it->first != *it->second / 4)
+        {
+            std::cerr << "FAILURE-" << name << ": Iterated key " << it->first << " with value " << *it->second
+                      << std::endl;
+            return false;
+        }
+        values.push_back(*it->second);
+    }
+    std::sort(values.begin(), values.end());
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (values.size() != COUNT || values[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Iterated " << values.size() << " values" << std::endl;
+            return false;
+        }
+    }
+    uint64_t sum = 0;
+    if (queue.ForEachInRange(10, 12, [&](uint64_t, uint64_t value) { sum += value; }) != 8 ||
+        sum != 40 + 41 + 42 + 43 + 44 + 45 + 46 + 47)
+    {
+        std::cerr << "FAILURE-" << name << ": Range summed to " << sum << std::endl;
+        return false;
+    }
+
+    std::atomic<bool> done(false);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            if (t == 0)
+            {
+                while (!done.load())
+                {
+                    uint64_t last = 0;
+                    for (auto it = queue.begin(); it != queue.end(); ++it)
+                    {
+                        if (it->first < last)
+                        {
+                            failed = true;
+                        }
+                        last = it->first;
+                    }
+                }
+                return;
+            }
+            uint64_t key = 0;
+            uint64_t value = 0;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                queue.Push(COUNT + i, i);
+                queue.TryPopStrong(key, value);
+            }
+        });
+    }
+    for (uint64_t t = 1; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+    done = true;
+    ts[0].join();
+    if (failed)
+    {
+        std::cerr << "FAILURE-" << name << ": Iterated out of order while popping" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Relaxed pops unlink popped nodes from the bottom level only, so ranges found from the levels above must not walk
+// through them into nodes already freed
+template <typename Q>
+bool run_relaxed(const char* name)
+{
+    Q queue;
+    for (uint64_t i = 0; i < COUNT / 5; i++)
+    {
+        queue.Push(i);
+    }
+    std::vector<bool> popped(COUNT / 5, false);
+    uint64_t key = 0;
+    for (uint64_t i = 0; i < COUNT / 8; i++)
+    {
+        if (queue.TryPopRelaxed(key, 64))
+        {
+            popped[key] = true;
+        }
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        CSLPQ::EpochDomain::Get().Collect();
+    }
+    for (uint64_t lo = 0; lo < COUNT / 5; lo += 50)
+    {
+        size_t expected = std::count(popped.begin() + lo, popped.begin() + std::min<uint64_t>(lo + 50, COUNT / 5),
+                                     false);
+        size_t count = queue.ForEachInRange(lo, lo + 50, [](uint64_t) {});
+        if (count != expected)
+        {
+            std::cerr << "FAILURE-" << name << ": Range from " << lo << " visited " << count << " keys expected "
+                      << expected << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run_keys<CSLPQ::Queue<uint64_t>>("Keys") ||
+        !run_keys<CSLPQ::Queue<uint64_t, 31, EpochTraits>>("EpochKeys") ||
+        !run_keys<CSLPQ::Queue<uint64_t, 31, TieTraits>>("TieKeys") ||
+        !run_relaxed<CSLPQ::Queue<uint64_t>>("Relaxed") ||
+        !run_relaxed<CSLPQ::Queue<uint64_t, 31, EpochTraits>>("EpochRelaxed") ||
+        !run_values<CSLPQ::KVQueue<uint64_t, uint64_t>>("Values") ||
+        !run_values<CSLPQ::KVQueue<uint64_t, uint64_t, 31, TieEpochTraits>>("TieEpochValues"))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+
+struct EpochTieTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+    typedef CSLPQ::TieBuckets<8> Ties;
+};
+
+struct Event
+{
+    uint64_t id;
+    uint32_t kind;
+
+    Event() : id(0), kind(0)
+    {
+    }
+
+    Event(uint64_t id, uint32_t kind) : id(id), kind(kind)
+    {
+    }
+};
+
+int main()
+{
+    // Keys round trip through a buffer and a stream, and come out in order
+    {
+        CSLPQ::Queue<uint64_t> queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push((i * 7919) % COUNT);
+        }
+        std::vector<char> buffer;
+        std::stringstream stream;
+        if (queue.Serialize(buffer) != COUNT || queue.Serialize(stream) != COUNT ||
+            buffer.size() != sizeof(CSLPQ::CheckpointHeader) + COUNT * sizeof(uint64_t) ||
+            stream.str() != std::string(buffer.begin(), buffer.end()))
+        {
+            std::cerr << "FAILURE: Checkpoint of " << buffer.size() << " bytes" << std::endl;
+            return 1;
+        }
+
+        CSLPQ::Queue<uint64_t> from_buffer;
+        CSLPQ::Queue<uint64_t> from_stream;
+        if (!from_buffer.Restore(buffer.data(), buffer.size()) || !from_stream.Restore(stream) ||
+            from_buffer.GetSize() != COUNT || from_stream.GetSize() != COUNT)
+        {
+            std::cerr << "FAILURE: Restore failed" << std::endl;
+            return 1;
+        }
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            uint64_t key = 0;
+            uint64_t other = 0;
+            if (!from_buffer.TryPop(key) || !from_stream.TryPop(other) || key != i || other != i)
+            {
+                std::cerr << "FAILURE: Read " << key << " and " << other << " expected " << i << std::endl;
+                return 1;
+            }
+        }
+
+        // Broken checkpoints and non empty queues are refused
+        CSLPQ::Queue<uint64_t> refused;
+        refused.Push(1);
+        if (refused.Restore(buffer.data(), buffer.size()) || from_buffer.Restore(buffer.data(), buffer.size() - 1) ||
+            from_buffer.Restore(buffer.data(), sizeof(CSLPQ::CheckpointHeader) - 1) || from_buffer.GetSize())
+        {
+            std::cerr << "FAILURE: Restored a broken checkpoint" << std::endl;
+            return 1;
+        }
+        std::stringstream truncated(std::string(buffer.begin(), buffer.end() - 1));
+        if (from_stream.Restore(truncated) || from_stream.GetSize() != COUNT - 1)
+        {
+            std::cerr << "FAILURE: Restored a truncated stream" << std::endl;
+            return 1;
+        }
+        std::vector<char> unsorted(buffer);
+        uint64_t key = 0;
+        std::memcpy(&unsorted[sizeof(CSLPQ::CheckpointHeader) + 10 * sizeof(uint64_t)], &key, sizeof(key));
+        CSLPQ::Queue<uint64_t> prefix;
+        if (prefix.Restore(unsorted.data(), unsorted.size()) || prefix.GetSize() != 10)
+        {
+            std::cerr << "FAILURE: Restored " << prefix.GetSize() << " keys of an unsorted checkpoint" << std::endl;
+            return 1;
+        }
+    }
+
+    // Elements round trip through a mapped file, with ties and epochs, and the queue keeps working after
+    {
+        typedef CSLPQ::KVQueue<uint64_t, Event, 31, EpochTieTraits> Q;
+        const char* path = "Func17.checkpoint";
+        {
+            Q queue;
+            for (uint64_t i = 0; i < COUNT; i++)
+            {
+                queue.Emplace(((i * 7919) % COUNT) / 4, (i * 7919) % COUNT, static_cast<uint32_t>(i % 3));
+            }
+            std::ofstream file(path, std::ios::binary);
+            if (queue.Serialize(file) != COUNT)
+            {
+                std::cerr << "FAILURE: Checkpointed fewer elements than pushed" << std::endl;
+                return 1;
+            }
+        }
+        Q queue;
+        {
+            CSLPQ::MappedFile file(path);
+            CSLPQ::Queue<uint64_t> keys;
+            if (!file.IsValid() || keys.Restore(file) || !queue.Restore(file))
+            {
+                std::cerr << "FAILURE: Restore from a mapped file" << std::endl;
+                return 1;
+            }
+        }
+        std::remove(path);
+        // Kind 3 marks the elements pushed after restoring, one past each end
+        queue.Emplace(COUNT, 4 * COUNT, 3);
+        queue.Emplace(0, 0, 3);
+        std::vector<bool> seen(COUNT, false);
+        uint64_t pushed = 0;
+        uint64_t last = 0;
+        for (uint64_t i = 0; i < COUNT + 2; i++)
+        {
+            uint64_t key = 0;
+            Event event;
+            if (!queue.TryPop(key, event) || key < last || key != event.id / 4 ||
+                (event.kind != 3 && seen[event.id]))
+            {
+                std::cerr << "FAILURE: Read " << key << ": " << event.id << " after " << last << std::endl;
+                return 1;
+            }
+            if (event.kind == 3)
+            {
+                pushed++;
+            }
+            else
+            {
+                seen[event.id] = true;
+            }
+            last = key;
+        }
+        if (pushed != 2)
+        {
+            std::cerr << "FAILURE: Read " << pushed << " elements pushed after restoring" << std::endl;
+            return 1;
+        }
+        if (queue.GetSize())
+        {
+            std::cerr << "FAILURE: Queue not empty after popping everything" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
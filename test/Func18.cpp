@@ -0,0 +1,171 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <functional>
+#include <iterator>
+
+#include "CSLPQ/Queue.hpp"
+#include "CSLPQ/Sharded.hpp"
+
+#define COUNT 20000
+
+struct MaxTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef std::greater<uint64_t> Compare;
+};
+
+struct MaxEpochTieTraits : MaxTraits
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+    typedef CSLPQ::TieBuckets<8> Ties;
+    typedef CSLPQ::LazyDeletion<16> Deletion;
+};
+
+// A key without comparison operators, ordered by its deadline only
+struct Deadline
+{
+    uint64_t at;
+    uint64_t id;
+};
+
+struct ByDeadline
+{
+    bool operator()(const Deadline& a, const Deadline& b) const
+    {
+        return a.at < b.at;
+    }
+};
+
+struct DeadlineTraits : CSLPQ::DefaultTraits<Deadline>
+{
+    typedef ByDeadline Compare;
+};
+
+// Keys come out largest first, through pops, bulk pushes, iteration, ranges and checkpoints
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(((i * 7919) % COUNT) / 2);
+    }
+    uint64_t expected = COUNT - 1;
+    for (uint64_t key : queue)
+    {
+        if (key != expected / 2)
+        {
+            std::cerr << "FAILURE-" << name << ": Iterated " << key << " expected " << expected / 2 << std::endl;
+            return false;
+        }
+        expected--;
+    }
+    size_t count = queue.ForEachInRange(COUNT / 4, COUNT / 4 - 50, [](uint64_t) {});
+    if (count != 100 || queue.ForEachInRange(COUNT / 4 - 50, COUNT / 4, [](uint64_t) {}))
+    {
+        std::cerr << "FAILURE-" << name << ": Range visited " << count << " keys" << std::endl;
+        return false;
+    }
+
+    std::vector<char> buffer;
+    Q restored;
+    if (queue.Serialize(buffer) != COUNT || !restored.Restore(buffer.data(), buffer.size()))
+    {
+        std::cerr << "FAILURE-" << name << ": Restore failed" << std::endl;
+        return false;
+    }
+
+    for (uint64_t i = COUNT; i > 0; i--)
+    {
+        uint64_t key = 0;
+        uint64_t other = 0;
+        if (!queue.TryPop(key) || !restored.TryPop(other) || key != (i - 1) / 2 || other != key)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " and " << other << " expected " << (i - 1) / 2
+                      << std::endl;
+            return false;
+        }
+    }
+
+    // Increasing keys are the new smallest each time and decreasing ones the new largest, both skip the search
+    std::vector<uint64_t> bulk;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (i % 2)
+        {
+            queue.Push(i);
+        }
+        else
+        {
+            bulk.push_back(COUNT - i);
+        }
+    }
+    queue.PushBulk(bulk.begin(), bulk.end());
+    std::vector<uint64_t> popped;
+    queue.TryPopN(std::back_inserter(popped), COUNT / 2);
+    uint64_t key = 0;
+    while (queue.TryPop(key))
+    {
+        popped.push_back(key);
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (popped.size() != COUNT || popped[i] != COUNT - i)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << popped.size() << " keys out of order" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::Queue<uint64_t, 31, MaxTraits>>("Max") ||
+        !run<CSLPQ::Queue<uint64_t, 31, MaxEpochTieTraits>>("MaxEpochTies"))
+    {
+        return 1;
+    }
+
+    // Elements with equal deadlines are ties, whatever else their keys hold
+    {
+        CSLPQ::KVQueue<Deadline, uint64_t, 31, DeadlineTraits> queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            uint64_t at = ((i * 7919) % COUNT) / 4;
+            queue.Push(Deadline{at, i}, at);
+        }
+        Deadline last{0, 0};
+        uint64_t value = 0;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            Deadline deadline{0, 0};
+            if (!queue.TryPop(deadline, value) || deadline.at < last.at || value != deadline.at ||
+                ((deadline.id * 7919) % COUNT) / 4 != deadline.at)
+            {
+                std::cerr << "FAILURE: Read deadline " << deadline.at << " after " << last.at << std::endl;
+                return 1;
+            }
+            last = deadline;
+        }
+    }
+
+    // Shards compare their minimums with the comparator of their queues
+    {
+        CSLPQ::ShardedQueue<uint64_t, 4, CSLPQ::Queue<uint64_t, 31, MaxTraits>> queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push((i * 7919) % COUNT);
+        }
+        for (uint64_t i = COUNT; i > 0; i--)
+        {
+            uint64_t key = 0;
+            if (!queue.TryPopStrict(key) || key != i - 1)
+            {
+                std::cerr << "FAILURE: Read " << key << " from shards expected " << i - 1 << std::endl;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define THREADS 4
+
+struct EpochTieTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+    typedef CSLPQ::TieBuckets<8> Ties;
+};
+
+// Steals take the smallest half, merges take everything, and both queues stay in order
+template <typename Q>
+bool run_keys(const char* name, uint64_t max_size = 0)
+{
+    Q victim(max_size);
+    Q thief(max_size);
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        victim.Push(((i * 7919) % COUNT) / 2);
+        thief.Push(COUNT + i);
+    }
+    if (thief.StealHalf(victim, 100) != 100 || thief.StealHalf(victim) != (COUNT - 100 + 1) / 2 ||
+        thief.StealHalf(thief) || victim.GetSize() != COUNT - 100 - (COUNT - 100 + 1) / 2)
+    {
+        std::cerr << "FAILURE-" << name << ": Stole the wrong number of keys" << std::endl;
+        return false;
+    }
+    uint64_t key = 0;
+    if (!victim.TryPeek(key) || key != (100 + (COUNT - 100 + 1) / 2) / 2)
+    {
+        std::cerr << "FAILURE-" << name << ": Victim kept " << key << " as its smallest key" << std::endl;
+        return false;
+    }
+
+    if (thief.Merge(std::move(victim)) != COUNT - 100 - (COUNT - 100 + 1) / 2 || victim.GetSize() ||
+        thief.GetSize() != 2 * COUNT || victim.StealHalf(thief, 0))
+    {
+        std::cerr << "FAILURE-" << name << ": Merged the wrong number of keys" << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < 2 * COUNT; i++)
+    {
+        if (!thief.TryPop(key) || key != (i < COUNT ? i / 2 : i))
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " after merging" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every worker pops its own queue and steals half of another when it runs dry, every element must come out exactly
+// once and values must stay with their keys
+template <typename Q>
+bool run_workers(const char* name)
+{
+    std::vector<std::unique_ptr<Q>> queues;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        queues.emplace_back(new Q());
+    }
+    // Work starts unbalanced, everything on the first worker
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queues[0]->Push(i / 4, i);
+    }
+    std::atomic<uint64_t> left(COUNT);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            uint64_t victim = t;
+            while (left.load())
+            {
+                if (queues[t]->TryPopStrong(key, value))
+                {
+                    if (key != value / 4)
+                    {
+                        popped[t].push_back(COUNT);
+                    }
+                    popped[t].push_back(value);
+                    left--;
+                    continue;
+                }
+                victim = (victim + 1) % THREADS;
+                if (victim != t)
+                {
+                    queues[t]->StealHalf(*queues[victim], 64);
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    for (uint64_t i = 0; i < all.size(); i++)
+    {
+        if (all.size() != COUNT || all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << all.size() << " elements, " << all[i] << " expected " << i
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Merges move nodes as they are: popped nodes in the middle are dropped, ties and values come along without being
+// copied, and handles keep working on the queue merged into
+template <typename Q>
+bool run_merge(const char* name)
+{
+    Q source;
+    Q target;
+    std::vector<typename Q::Handle> handles;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        uint64_t key = ((i * 7919) % COUNT) / 2;
+        if (i % 100 == 0)
+        {
+            handles.push_back(source.PushWithHandle(key, std::unique_ptr<uint64_t>(new uint64_t(key))));
+        }
+        else
+        {
+            source.Push(key, std::unique_ptr<uint64_t>(new uint64_t(key)));
+        }
+        target.Push(COUNT + i, std::unique_ptr<uint64_t>(new uint64_t(COUNT + i)));
+    }
+    uint64_t key = 0;
+    std::unique_ptr<uint64_t> value;
+    uint64_t relaxed = 0;
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        relaxed += source.TryPopRelaxed(key, value, 64);
+    }
+    uint64_t erased = 0;
+    for (size_t i = 0; i < handles.size() / 2; i++)
+    {
+        erased += source.Erase(handles[i]);
+    }
+    uint64_t left = COUNT - relaxed - erased;
+    if (target.Merge(std::move(source)) != left || source.GetSize() || target.GetSize() != COUNT + left)
+    {
+        std::cerr << "FAILURE-" << name << ": Merged the wrong number of elements" << std::endl;
+        return false;
+    }
+    for (size_t i = handles.size() / 2; i < handles.size(); i++)
+    {
+        erased += target.Erase(handles[i]);
+    }
+    source.Push(1, std::unique_ptr<uint64_t>(new uint64_t(1)));
+    uint64_t last = 0;
+    uint64_t count = 0;
+    while (target.TryPop(key, value))
+    {
+        if (!value || *value != key || key < last)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " after " << last << std::endl;
+            return false;
+        }
+        last = key;
+        ++count;
+    }
+    if (count != COUNT + COUNT - relaxed - erased || !source.TryPop(key, value) || key != 1)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << count << " elements after merging" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run_keys<CSLPQ::Queue<uint64_t>>("Keys") ||
+        !run_keys<CSLPQ::Queue<uint64_t, 31, EpochTieTraits>>("EpochTieKeys") ||
+        !run_keys<CSLPQ::Queue<uint64_t>>("BoundedKeys", 4 * COUNT) ||
+        !run_workers<CSLPQ::KVQueue<uint64_t, uint64_t>>("Workers") ||
+        !run_workers<CSLPQ::KVQueue<uint64_t, uint64_t, 31, EpochTieTraits>>("EpochTieWorkers") ||
+        !run_merge<CSLPQ::KVQueue<uint64_t, std::unique_ptr<uint64_t>>>("Merge") ||
+        !run_merge<CSLPQ::KVQueue<uint64_t, std::unique_ptr<uint64_t>, 31, EpochTieTraits>>("EpochTieMerge"))
+    {
+        return 1;
+    }
+    return 0;
+}
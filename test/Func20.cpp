@@ -0,0 +1,134 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define THREADS 4
+
+static_assert(CSLPQ::caches_key<uint64_t>::value && CSLPQ::caches_key<uint32_t>::value,
+              "Word sized keys are copied next to links");
+static_assert(!CSLPQ::caches_key<std::pair<uint64_t, uint64_t>>::value,
+              "Keys larger than a word are only read from their nodes");
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+struct MaxTraits : CSLPQ::DefaultTraits<uint32_t>
+{
+    typedef std::greater<uint32_t> Compare;
+};
+
+struct WideKey
+{
+    uint64_t high;
+    uint64_t low;
+};
+
+struct ByWideKey
+{
+    bool operator()(const WideKey& a, const WideKey& b) const
+    {
+        return a.high < b.high || (a.high == b.high && a.low < b.low);
+    }
+};
+
+struct WideTraits : CSLPQ::DefaultTraits<WideKey>
+{
+    typedef ByWideKey Compare;
+};
+
+template <typename K>
+K MakeKey(uint64_t i)
+{
+    return static_cast<K>(i);
+}
+
+template <>
+WideKey MakeKey<WideKey>(uint64_t i)
+{
+    return WideKey{i / 16, i % 16};
+}
+
+// Threads push keys all over the queue at once, so searches keep stopping on copies of keys that lag their links,
+// while handles are erased behind them. Everything left must come out in order, every key once.
+template <typename Q, typename K>
+bool run(const char* name)
+{
+    Q queue;
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            std::vector<typename Q::Handle> handles;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                uint64_t shuffled = (i * 7919) % COUNT;
+                if ((i / THREADS) % 8 == 0)
+                {
+                    handles.push_back(queue.PushWithHandle(MakeKey<K>(shuffled)));
+                }
+                else
+                {
+                    queue.Push(MakeKey<K>(shuffled));
+                }
+                if (handles.size() == 4)
+                {
+                    queue.Erase(handles.front());
+                    handles.erase(handles.begin());
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    typename Q::Compare less;
+    std::vector<K> popped;
+    K key = K();
+    while (queue.TryPop(key))
+    {
+        if (!popped.empty() && less(key, popped.back()))
+        {
+            std::cerr << "FAILURE-" << name << ": Read a key out of order after " << popped.size() << std::endl;
+            return false;
+        }
+        popped.push_back(key);
+    }
+    // Each thread erased all but the last 3 of its handles, a key out of 8 went to a handle
+    uint64_t expected = COUNT - (COUNT / 8 - THREADS * 3);
+    if (popped.size() != expected || queue.GetSize())
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << popped.size() << " keys expected " << expected << std::endl;
+        return false;
+    }
+    for (size_t i = 1; i < popped.size(); i++)
+    {
+        if (!less(popped[i - 1], popped[i]))
+        {
+            std::cerr << "FAILURE-" << name << ": Read a key twice" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::Queue<uint64_t>, uint64_t>("Shared") ||
+        !run<CSLPQ::Queue<uint64_t, 31, EpochTraits>, uint64_t>("Epoch") ||
+        !run<CSLPQ::Queue<uint32_t, 31, MaxTraits>, uint32_t>("Max") ||
+        !run<CSLPQ::Queue<WideKey, 31, WideTraits>, WideKey>("Wide"))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include <iostream>
+#include <thread>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 200000
+
+// Destroyed at exit after the thread_local objects of the main thread, with chains of nodes long enough that deleting
+// them by recursion would overflow the stack
+CSLPQ::KVQueue<uint64_t, void*> values;
+CSLPQ::Queue<uint64_t> keys;
+
+int main()
+{
+    std::thread([]()
+    {
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            values.Push(i, nullptr);
+            keys.Push(COUNT - i);
+        }
+    }).join();
+    // Deleting popped nodes on the main thread sets up its deletion state before exit
+    uint64_t key = 0;
+    void* value = nullptr;
+    for (uint64_t i = 0; i < COUNT / 2; i++)
+    {
+        if (!values.TryPop(key, value) || key != i || !keys.TryPop(key) || key != i + 1)
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
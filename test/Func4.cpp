@@ -0,0 +1,79 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 10000
+
+struct QuarterTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::GeometricLevel<4> LevelGenerator;
+};
+
+struct UniformTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::UniformLevel LevelGenerator;
+};
+
+template <typename Q>
+bool run(const char* name, const std::vector<uint64_t>& keys)
+{
+    Q queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(keys[i]);
+    }
+
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPop(key))
+        {
+            std::cerr << "FAILURE-" << name << ": Queue empty after " << i << " pops" << std::endl;
+            return false;
+        }
+        if (key != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " expected " << i << std::endl;
+            return false;
+        }
+    }
+    uint64_t key;
+    if (queue.TryPop(key))
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << key << " from empty queue" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    // Every level must stay within bounds
+    for (uint64_t i = 0; i < 100000; i++)
+    {
+        uint32_t level = CSLPQ::GeometricLevel<4>::Generate(5);
+        if (level < 1 || level > 5)
+        {
+            std::cerr << "FAILURE: Generated level " << level << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    if (!run<CSLPQ::Queue<uint64_t>>("Default", keys) ||
+        !run<CSLPQ::Queue<uint64_t, 8, QuarterTraits>>("Quarter", keys) ||
+        !run<CSLPQ::Queue<uint64_t, 4, UniformTraits>>("Uniform", keys))
+    {
+        return 1;
+    }
+
+    return 0;
+}
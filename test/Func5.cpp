@@ -0,0 +1,104 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 10000
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+std::atomic<int64_t> live(0);
+
+struct Tracked
+{
+    uint64_t value;
+
+    Tracked() : value(0)
+    {
+        live++;
+    }
+
+    Tracked(uint64_t value) : value(value)
+    {
+        live++;
+    }
+
+    Tracked(const Tracked& other) : value(other.value)
+    {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+
+    ~Tracked()
+    {
+        live--;
+    }
+};
+
+int main()
+{
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    {
+        CSLPQ::Queue<uint64_t, 8, EpochTraits> queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(keys[i]);
+        }
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            uint64_t key = 0;
+            if (!queue.TryPop(key) || key != i)
+            {
+                std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    {
+        CSLPQ::KVQueue<uint64_t, Tracked, 8, EpochTraits> queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(keys[i], Tracked(keys[i] * 2));
+        }
+        // Pop half, the rest is freed by the destructor
+        for (uint64_t i = 0; i < COUNT / 2; i++)
+        {
+            uint64_t key = 0;
+            Tracked value;
+            if (!queue.TryPop(key, value) || key != i || value.value != i * 2)
+            {
+                std::cerr << "FAILURE: Read " << key << ": " << value.value << " expected " << i << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Popped nodes are retired, run enough collections for the epoch to move past them
+    for (int i = 0; i < 4; i++)
+    {
+        CSLPQ::EpochDomain::Get().Collect();
+    }
+    if (live != 0)
+    {
+        std::cerr << "FAILURE: " << live << " values leaked" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 10000
+
+struct PooledTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::PoolAllocator<uint64_t> Allocator;
+};
+
+struct PooledEpochTraits : PooledTraits
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+std::atomic<int64_t> live(0);
+
+struct Tracked
+{
+    uint64_t value;
+
+    Tracked() : value(0)
+    {
+        live++;
+    }
+
+    Tracked(uint64_t value) : value(value)
+    {
+        live++;
+    }
+
+    Tracked(const Tracked& other) : value(other.value)
+    {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+
+    ~Tracked()
+    {
+        live--;
+    }
+};
+
+template <typename Q>
+bool run(const char* name, const std::vector<uint64_t>& keys)
+{
+    // Several rounds, later ones are served from blocks freed by earlier ones
+    for (int round = 0; round < 3; round++)
+    {
+        Q queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(keys[i], Tracked(keys[i] * 2));
+        }
+        for (uint64_t i = 0; i < COUNT / 2; i++)
+        {
+            uint64_t key = 0;
+            Tracked value;
+            if (!queue.TryPop(key, value) || key != i || value.value != i * 2)
+            {
+                std::cerr << "FAILURE-" << name << ": Read " << key << ": " << value.value << " expected " << i
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Nodes are allocated by one thread and freed by another, blocks travel through the depot
+    Q queue;
+    std::atomic<bool> failed(false);
+    std::thread producer([&]()
+    {
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(i, Tracked(i));
+        }
+    });
+    std::thread consumer([&]()
+    {
+        uint64_t popped = 0;
+        while (popped < COUNT)
+        {
+            uint64_t key = 0;
+            Tracked value;
+            if (queue.TryPop(key, value))
+            {
+                if (key != value.value)
+                {
+                    failed = true;
+                }
+                popped++;
+            }
+        }
+        CSLPQ::EpochDomain::Get().Collect();
+    });
+    producer.join();
+    consumer.join();
+    if (failed)
+    {
+        std::cerr << "FAILURE-" << name << ": Read mismatching key and value" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// A thread that only frees returns the blocks it cached when it exits. Blocks of this size are a slab each, so blocks
+// allocated afterwards are the freed ones only if they went back to the depot.
+bool run_consumer()
+{
+    typedef CSLPQ::BlockPool<64 * 1024> Pool;
+    std::vector<void*> blocks;
+    for (int i = 0; i < 100; i++)
+    {
+        blocks.push_back(Pool::Allocate());
+    }
+    std::thread([&]()
+    {
+        for (void* block : blocks)
+        {
+            Pool::Deallocate(block);
+        }
+    }).join();
+    std::sort(blocks.begin(), blocks.end());
+    std::vector<void*> again;
+    for (int i = 0; i < 100; i++)
+    {
+        again.push_back(Pool::Allocate());
+        if (!std::binary_search(blocks.begin(), blocks.end(), again.back()))
+        {
+            std::cerr << "FAILURE: Allocated a new block after " << i << " freed ones" << std::endl;
+            return false;
+        }
+    }
+    for (void* block : again)
+    {
+        Pool::Deallocate(block);
+    }
+    return true;
+}
+
+int main()
+{
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    if (!run<CSLPQ::KVQueue<uint64_t, Tracked, 8, PooledTraits>>("Shared", keys) ||
+        !run<CSLPQ::KVQueue<uint64_t, Tracked, 8, PooledEpochTraits>>("Epoch", keys) || !run_consumer())
+    {
+        return 1;
+    }
+
+    {
+        CSLPQ::Queue<uint64_t, 8, PooledTraits> queue;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(keys[i]);
+        }
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            uint64_t key = 0;
+            if (!queue.TryPop(key) || key != i)
+            {
+                std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        CSLPQ::EpochDomain::Get().Collect();
+    }
+    if (live != 0)
+    {
+        std::cerr << "FAILURE: " << live << " values leaked" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 1000
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+int main()
+{
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    CSLPQ::Queue<uint64_t> queue;
+    uint64_t key = 0;
+    if (queue.TryPeek(key))
+    {
+        std::cerr << "FAILURE: Peeked " << key << " in empty queue" << std::endl;
+        return 1;
+    }
+    queue.PushBulk(keys.begin(), keys.end());
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        // Peeking twice sees the same key, popping afterwards gets it
+        uint64_t peeked = 0;
+        if (!queue.TryPeek(peeked) || !queue.TryPeek(key) || peeked != i || key != i ||
+            !queue.TryPop(key) || key != i)
+        {
+            std::cerr << "FAILURE: Peeked " << peeked << " and read " << key << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+    if (queue.TryPeek(key))
+    {
+        std::cerr << "FAILURE: Peeked " << key << " in emptied queue" << std::endl;
+        return 1;
+    }
+
+    CSLPQ::KVQueue<uint64_t, uint64_t, 4, EpochTraits> kvqueue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        kvqueue.Push(keys[i], keys[i] * 2);
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        uint64_t value = 0;
+        if (!kvqueue.TryPeek(key, value) || key != i || value != i * 2)
+        {
+            std::cerr << "FAILURE: Peeked " << key << ": " << value << " expected " << i << std::endl;
+            return 1;
+        }
+        if (!kvqueue.TryPop(key, value) || key != i)
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
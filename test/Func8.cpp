@@ -0,0 +1,154 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 1000
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+uint64_t copies = 0;
+
+struct Payload
+{
+    uint64_t value;
+
+    Payload() : value(0)
+    {
+    }
+
+    explicit Payload(uint64_t value) : value(value)
+    {
+    }
+
+    Payload(const Payload& other) : value(other.value)
+    {
+        copies++;
+    }
+
+    Payload(Payload&& other) : value(other.value)
+    {
+    }
+
+    Payload& operator=(const Payload& other)
+    {
+        this->value = other.value;
+        copies++;
+        return *this;
+    }
+
+    Payload& operator=(Payload&& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+};
+
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    // Move only values go in by move, by emplace and by a moving bulk push
+    std::vector<std::pair<uint64_t, std::unique_ptr<uint64_t>>> batch;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (i % 3 == 0)
+        {
+            std::unique_ptr<uint64_t> value(new uint64_t(keys[i]));
+            queue.Push(keys[i], std::move(value));
+        }
+        else if (i % 3 == 1)
+        {
+            queue.Emplace(keys[i], new uint64_t(keys[i]));
+        }
+        else
+        {
+            batch.emplace_back(keys[i], std::unique_ptr<uint64_t>(new uint64_t(keys[i])));
+        }
+    }
+    queue.PushBulk(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+
+    // And come out by move through every pop
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        uint64_t key = 0;
+        std::unique_ptr<uint64_t> value;
+        bool success = false;
+        if (i % 4 == 0)
+        {
+            success = queue.TryPop(key, value);
+        }
+        else if (i % 4 == 1)
+        {
+            success = queue.TryPopStrong(key, value);
+        }
+        else if (i % 4 == 2)
+        {
+            std::vector<std::pair<uint64_t, std::unique_ptr<uint64_t>>> out;
+            success = queue.TryPopN(std::back_inserter(out), 1) == 1;
+            if (success)
+            {
+                key = out[0].first;
+                value = std::move(out[0].second);
+            }
+        }
+        else
+        {
+            queue.Pop(key, value);
+            success = true;
+        }
+        if (!success || key != i || !value || *value != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " expected " << i << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, std::unique_ptr<uint64_t>>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, std::unique_ptr<uint64_t>, 4, EpochTraits>>("Epoch"))
+    {
+        return 1;
+    }
+
+    // Copyable values are not copied on the way in or out either
+    CSLPQ::KVQueue<uint64_t, Payload> queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push(COUNT - 1 - i, Payload(COUNT - 1 - i));
+        queue.Emplace(COUNT + i, COUNT + i);
+    }
+    for (uint64_t i = 0; i < 2 * COUNT; i++)
+    {
+        uint64_t key = 0;
+        Payload value;
+        if (!queue.TryPopStrong(key, value) || key != i || value.value != i)
+        {
+            std::cerr << "FAILURE: Read " << key << ": " << value.value << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+    if (copies)
+    {
+        std::cerr << "FAILURE: Values were copied " << copies << " times" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
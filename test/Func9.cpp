@@ -0,0 +1,198 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+#include "CSLPQ/Queue.hpp"
+
+#define KEYS 50
+#define TIES 40
+
+// Small buckets, so ties also overflow into further nodes of the same key
+struct TieTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::TieBuckets<8> Ties;
+};
+
+struct TieEpochTraits : TieTraits
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+std::atomic<int64_t> live(0);
+
+struct Tracked
+{
+    uint64_t value;
+
+    Tracked() : value(0)
+    {
+        live++;
+    }
+
+    Tracked(uint64_t value) : value(value)
+    {
+        live++;
+    }
+
+    Tracked(const Tracked& other) : value(other.value)
+    {
+        live++;
+    }
+
+    Tracked& operator=(const Tracked& other)
+    {
+        this->value = other.value;
+        return *this;
+    }
+
+    ~Tracked()
+    {
+        live--;
+    }
+};
+
+// Values are key * TIES + tie, so every element can be told apart
+template <typename Q>
+bool run(const char* name)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> items;
+    for (uint64_t key = 0; key < KEYS; key++)
+    {
+        for (uint64_t tie = 0; tie < TIES; tie++)
+        {
+            items.emplace_back(key, key * TIES + tie);
+        }
+    }
+    std::random_shuffle(items.begin(), items.end());
+
+    {
+        Q queue;
+        for (size_t i = 0; i < items.size() / 2; i++)
+        {
+            queue.Push(items[i].first, Tracked(items[i].second));
+        }
+        std::vector<std::pair<uint64_t, Tracked>> rest;
+        for (size_t i = items.size() / 2; i < items.size(); i++)
+        {
+            rest.emplace_back(items[i].first, Tracked(items[i].second));
+        }
+        queue.PushBulk(rest.begin(), rest.end());
+        if (queue.GetSize() != KEYS * TIES)
+        {
+            std::cerr << "FAILURE-" << name << ": Size " << queue.GetSize() << " expected " << KEYS * TIES
+                      << std::endl;
+            return false;
+        }
+
+        std::vector<bool> seen(KEYS * TIES, false);
+        uint64_t last = 0;
+        for (uint64_t i = 0; i < KEYS * TIES; i++)
+        {
+            uint64_t key = 0;
+            Tracked value;
+            bool popped = false;
+            switch (i % 3)
+            {
+                case 0:
+                    popped = queue.TryPopStrong(key, value);
+                    break;
+                case 1:
+                    popped = queue.TryPop(key, value);
+                    break;
+                default:
+                {
+                    std::vector<std::pair<uint64_t, Tracked>> out;
+                    popped = queue.TryPopN(std::back_inserter(out), 1) == 1;
+                    if (popped)
+                    {
+                        key = out[0].first;
+                        value = out[0].second;
+                    }
+                }
+            }
+            if (!popped || key < last || value.value / TIES != key || seen[value.value])
+            {
+                std::cerr << "FAILURE-" << name << ": Read " << key << ": " << value.value << " after " << last
+                          << std::endl;
+                return false;
+            }
+            seen[value.value] = true;
+            last = key;
+        }
+        uint64_t key = 0;
+        Tracked value;
+        if (queue.TryPopStrong(key, value))
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << " from empty queue" << std::endl;
+            return false;
+        }
+
+        // Ties left in the queue are destroyed with it
+        for (uint64_t i = 0; i < TIES; i++)
+        {
+            queue.Push(7, Tracked(i));
+        }
+    }
+    // Popped epoch nodes are freed after two epoch steps
+    for (int i = 0; i < 4; i++)
+    {
+        CSLPQ::EpochDomain::Get().Collect();
+    }
+    if (live.load() != 0)
+    {
+        std::cerr << "FAILURE-" << name << ": " << live.load() << " values leaked" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, Tracked, 8, TieTraits>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, Tracked, 8, TieEpochTraits>>("Epoch"))
+    {
+        return 1;
+    }
+
+    // Keys only, ties in batches
+    CSLPQ::Queue<uint64_t, 8, TieTraits> queue;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < KEYS * TIES; i++)
+    {
+        keys.emplace_back(i % KEYS);
+    }
+    queue.PushBulk(keys.begin(), keys.end());
+    std::vector<uint64_t> popped;
+    while (queue.TryPopN(std::back_inserter(popped), 64))
+    {
+    }
+    std::sort(keys.begin(), keys.end());
+    if (popped != keys)
+    {
+        std::cerr << "FAILURE: Read " << popped.size() << " keys, not the pushed ones in order" << std::endl;
+        return 1;
+    }
+
+    // Move only ties
+    CSLPQ::KVQueue<uint64_t, std::unique_ptr<uint64_t>, 8, TieTraits> unique;
+    for (uint64_t i = 0; i < TIES; i++)
+    {
+        unique.Emplace(3, new uint64_t(i));
+    }
+    std::vector<bool> seen(TIES, false);
+    for (uint64_t i = 0; i < TIES; i++)
+    {
+        uint64_t key = 0;
+        std::unique_ptr<uint64_t> value;
+        if (!unique.TryPopStrong(key, value) || key != 3 || !value || *value >= TIES || seen[*value])
+        {
+            std::cerr << "FAILURE: Read a wrong move only tie" << std::endl;
+            return 1;
+        }
+        seen[*value] = true;
+    }
+
+    return 0;
+}
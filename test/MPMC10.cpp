@@ -0,0 +1,166 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "CSLPQ/Sharded.hpp"
+
+#define COUNT 40000
+#define LEFT 5000
+#define THREADS 4
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+// Stands in for two NUMA nodes, threads say which one they run on
+thread_local uint32_t node = 0;
+
+struct TwoNodes
+{
+    static uint32_t Groups()
+    {
+        return 2;
+    }
+
+    static uint32_t Group()
+    {
+        return node;
+    }
+};
+
+// Every thread pushes to its own shard and pops from any, then the elements pushed last are drained strictly in order
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::atomic<uint64_t> pushed(0);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            node = t % 2;
+            uint64_t key = 0;
+            uint64_t value = 0;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                queue.Push((i * 7919) % COUNT, i);
+                pushed++;
+                if (i % 2 == 0 && queue.TryPop(key, value))
+                {
+                    popped[t].push_back((value * 7919) % COUNT == key ? value : COUNT);
+                }
+            }
+            while (pushed.load() < COUNT || queue.GetSize())
+            {
+                if (queue.TryPop(key, value))
+                {
+                    popped[t].push_back((value * 7919) % COUNT == key ? value : COUNT);
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.size() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << all.size() << " elements expected " << COUNT << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Element " << i << " missing, read twice or with a wrong key"
+                      << std::endl;
+            return false;
+        }
+    }
+
+    // Several threads fill several shards, the strict drain merges them
+    ts.clear();
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            node = t % 2;
+            for (uint64_t i = t; i < LEFT; i += THREADS)
+            {
+                queue.Push((i * 7919) % LEFT, i);
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+    if (queue.GetSize() != LEFT)
+    {
+        std::cerr << "FAILURE-" << name << ": Size " << queue.GetSize() << " expected " << LEFT << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < LEFT; i++)
+    {
+        uint64_t key = 0;
+        uint64_t value = 0;
+        if (!queue.TryPopStrict(key, value) || key != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Drained " << key << " expected " << i << std::endl;
+            return false;
+        }
+    }
+    uint64_t key = 0;
+    uint64_t value = 0;
+    if (queue.TryPop(key, value) || queue.TryPopStrict(key, value))
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << key << " from empty queue" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    typedef CSLPQ::KVShardedQueue<uint64_t, uint64_t, THREADS> SharedQueue;
+    typedef CSLPQ::KVShardedQueue<uint64_t, uint64_t, 3, CSLPQ::KVQueue<uint64_t, uint64_t, 31, EpochTraits>> EpochQueue;
+    typedef CSLPQ::KVShardedQueue<uint64_t, uint64_t, 5, CSLPQ::KVQueue<uint64_t, uint64_t>, TwoNodes> GroupedQueue;
+    typedef CSLPQ::KVShardedQueue<uint64_t, uint64_t, 4, CSLPQ::KVQueue<uint64_t, uint64_t>, CSLPQ::NumaAffinity> NumaQueue;
+
+    if (!run<SharedQueue>("Shared") || !run<EpochQueue>("Epoch") || !run<GroupedQueue>("Grouped") ||
+        !run<NumaQueue>("Numa"))
+    {
+        return 1;
+    }
+
+    // Keys only
+    CSLPQ::ShardedQueue<uint64_t, 2> keys;
+    std::vector<uint64_t> batch;
+    for (uint64_t i = 0; i < LEFT; i++)
+    {
+        batch.push_back(LEFT - 1 - i);
+    }
+    keys.PushBulk(batch.begin(), batch.end());
+    for (uint64_t i = 0; i < LEFT; i++)
+    {
+        uint64_t key = 0;
+        if (!keys.TryPopStrict(key) || key != i)
+        {
+            std::cerr << "FAILURE: Drained " << key << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define THREADS 4
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+// Every thread pushes with handles and then erases or moves its own elements while the others pop, so erases and
+// moves race with pops of the same elements. Every element must be popped or erased exactly once.
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::atomic<uint64_t> done(0);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::vector<uint64_t>> erased(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            std::vector<typename Q::Handle> handles;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                handles.push_back(queue.PushWithHandle((i * 7919) % COUNT, i));
+                if (i % 4 == 0 && queue.TryPopStrong(key, value))
+                {
+                    popped[t].push_back(value);
+                }
+            }
+            for (uint64_t j = 0; j < handles.size(); j++)
+            {
+                uint64_t i = t + j * THREADS;
+                if (i % 3 == 0 && queue.Erase(handles[j]))
+                {
+                    erased[t].push_back(i);
+                }
+                else if (i % 3 == 1)
+                {
+                    queue.UpdatePriority(handles[j], (i * 31) % COUNT);
+                }
+                if (j % 2 && queue.TryPopStrong(key, value))
+                {
+                    popped[t].push_back(value);
+                }
+            }
+            done++;
+            while (done.load() < THREADS || queue.GetSize())
+            {
+                if (queue.TryPopStrong(key, value))
+                {
+                    popped[t].push_back(value);
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+        all.insert(all.end(), erased[t].begin(), erased[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.size() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read and erased " << all.size() << " elements expected " << COUNT
+                  << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Element " << i << " missing, or read or erased twice" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, uint64_t>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, EpochTraits>>("Epoch"))
+    {
+        return 1;
+    }
+    return 0;
+}
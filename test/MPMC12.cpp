@@ -0,0 +1,105 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define THREADS 4
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+struct StripedTraits : EpochTraits
+{
+    typedef CSLPQ::StripedCounter<> Counter;
+};
+
+struct LazyTraits : EpochTraits
+{
+    typedef CSLPQ::LazyDeletion<> Deletion;
+};
+
+// Every thread pushes its share and pops in between, while thread 0 also clears the queue now and then and the last
+// thread drains it. Every element must be popped, drained or cleared exactly once, and the counts must add up.
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::atomic<uint64_t> done(0);
+    std::atomic<uint64_t> cleared(0);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                queue.Push((i * 7919) % COUNT, i);
+                if (i % 3 == 0 && queue.TryPopStrong(key, value))
+                {
+                    popped[t].push_back(value);
+                }
+                if (t == 0 && i % 1000 == 0)
+                {
+                    cleared += queue.Clear();
+                }
+            }
+            done++;
+            if (t == THREADS - 1)
+            {
+                std::vector<std::pair<uint64_t, uint64_t>> drained;
+                while (done.load() < THREADS || queue.GetSize())
+                {
+                    queue.DrainTo(std::back_inserter(drained));
+                }
+                for (size_t i = 0; i < drained.size(); i++)
+                {
+                    popped[t].push_back(drained[i].second);
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.size() + cleared.load() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << all.size() << " and cleared " << cleared.load()
+                  << " elements expected " << COUNT << std::endl;
+        return false;
+    }
+    if (std::adjacent_find(all.begin(), all.end()) != all.end())
+    {
+        std::cerr << "FAILURE-" << name << ": Element read twice" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, uint64_t>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, EpochTraits>>("Epoch") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, StripedTraits>>("Striped") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 31, LazyTraits>>("Lazy"))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+#include "CSLPQ/Elimination.hpp"
+
+#define COUNT 20000
+#define THREADS 4
+
+// Constructing one in a slot always fails, late enough for the pop waiting in it to see the slot claimed
+struct Throwing
+{
+    explicit Throwing(int)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        throw std::runtime_error("Throwing");
+    }
+};
+
+// Half the threads push keys that mostly stay near the minimum while the other half pop, every element must come out
+// exactly once whether it went through the queue, a slot or a combining pop
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::atomic<uint64_t> done(0);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            if (t % 2 == 0)
+            {
+                for (uint64_t i = t / 2; i < COUNT; i += THREADS / 2)
+                {
+                    queue.Push(i / 64, std::unique_ptr<uint64_t>(new uint64_t(i)));
+                }
+                done++;
+                return;
+            }
+            uint64_t key = 0;
+            std::unique_ptr<uint64_t> value;
+            while (true)
+            {
+                if (queue.TryPop(key, value))
+                {
+                    if (!value || key != *value / 64)
+                    {
+                        std::cerr << "FAILURE-" << name << ": Read key " << key << " with a wrong value" << std::endl;
+                        popped[t].push_back(COUNT);
+                        return;
+                    }
+                    popped[t].push_back(*value);
+                }
+                else if (done.load() == THREADS / 2 && !queue.GetSize())
+                {
+                    return;
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    for (uint64_t i = 0; i < all.size(); i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << all[i] << " expected " << i << std::endl;
+            return false;
+        }
+    }
+    if (all.size() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << all.size() << " elements expected " << COUNT << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVEliminationQueue<uint64_t, std::unique_ptr<uint64_t>>>("KV") ||
+        !run<CSLPQ::KVEliminationQueue<uint64_t, std::unique_ptr<uint64_t>, 1>>("OneSlot"))
+    {
+        return 1;
+    }
+
+    // A pop whose slot was claimed by a fill that then threw gives up instead of waiting for an element forever
+    {
+        CSLPQ::Exchanger<Throwing, 1> exchanger;
+        std::atomic<bool> thrown(false);
+        std::thread waiter([&]()
+        {
+            while (!thrown.load())
+            {
+                exchanger.Wait([](Throwing&&) {});
+            }
+        });
+        while (!thrown.load())
+        {
+            int index = exchanger.Waiter();
+            try
+            {
+                if (index >= 0)
+                {
+                    exchanger.Fill(index, false, 0);
+                }
+            }
+            catch (const std::runtime_error&)
+            {
+                thrown = true;
+            }
+        }
+        waiter.join();
+    }
+
+    // Without other threads nothing is handed over, keys come out in order
+    CSLPQ::EliminationQueue<uint64_t> queue;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        queue.Push((i * 7919) % COUNT);
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPop(key) || key != i)
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+    uint64_t key = 0;
+    if (queue.TryPop(key) || queue.GetEliminated() || queue.GetCombined())
+    {
+        std::cerr << "FAILURE: Elements handed over without other threads" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 40000
+#define THREADS 4
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+// Every push returns before the first pop, so a strong pop may only fail once the queue has been drained
+template <typename Q, typename P>
+bool run(const char* name, P pop)
+{
+    Q queue;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            for (uint64_t i = t * COUNT / THREADS; i < (t + 1) * COUNT / THREADS; i++)
+            {
+                queue.Push(keys[i], keys[i]);
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+    ts.clear();
+
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            uint64_t key = 0;
+            while (pop(queue, key))
+            {
+                popped[t].push_back(key);
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        // Each consumer must see increasing keys
+        if (!std::is_sorted(popped[t].begin(), popped[t].end()))
+        {
+            std::cerr << "FAILURE-" << name << ": Thread " << t << " read keys out of order" << std::endl;
+            return false;
+        }
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    if (all.size() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << all.size() << " keys expected " << COUNT << std::endl;
+        return false;
+    }
+    std::sort(all.begin(), all.end());
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Key " << i << " missing or read twice" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    typedef CSLPQ::KVQueue<uint64_t, uint64_t> SharedQueue;
+    typedef CSLPQ::KVQueue<uint64_t, uint64_t, 8, EpochTraits> EpochQueue;
+
+    bool success = run<SharedQueue>("Shared", [](SharedQueue& queue, uint64_t& key)
+    {
+        uint64_t value = 0;
+        return queue.TryPopStrong(key, value) && key == value;
+    });
+    success = success && run<EpochQueue>("Epoch", [](EpochQueue& queue, uint64_t& key)
+    {
+        uint64_t value = 0;
+        return queue.TryPopStrong(key, value) && key == value;
+    });
+    if (!success)
+    {
+        return 1;
+    }
+
+    CSLPQ::Queue<uint64_t> queue;
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        queue.Push(99 - i);
+    }
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPopStrong(key) || key != i)
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+    uint64_t key;
+    if (queue.TryPopStrong(key))
+    {
+        std::cerr << "FAILURE: Read " << key << " from empty queue" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
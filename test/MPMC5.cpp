@@ -0,0 +1,121 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 40000
+#define THREADS 4
+#define BATCH 16
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    std::atomic<uint64_t> count(0);
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            for (uint64_t i = t * COUNT / THREADS; i < (t + 1) * COUNT / THREADS; i++)
+            {
+                queue.Push(keys[i], keys[i] + 1);
+            }
+        });
+        ts.emplace_back([&, t]()
+        {
+            while (count < COUNT)
+            {
+                count += queue.TryPopN(std::back_inserter(popped[t]), BATCH);
+            }
+        });
+    }
+    for (uint64_t t = 0; t < 2 * THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        for (uint64_t i = 0; i < popped[t].size(); i++)
+        {
+            if (popped[t][i].second != popped[t][i].first + 1)
+            {
+                std::cerr << "FAILURE-" << name << ": Read " << popped[t][i].first << ": " << popped[t][i].second
+                          << std::endl;
+                return false;
+            }
+            all.push_back(popped[t][i].first);
+        }
+    }
+    std::sort(all.begin(), all.end());
+    if (all.size() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << all.size() << " keys expected " << COUNT << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Key " << i << " missing or read twice" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    // Batches come out in order, a short queue fills only part of the request
+    CSLPQ::Queue<uint64_t> queue;
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        queue.Push(99 - i);
+    }
+    std::vector<uint64_t> keys;
+    if (queue.TryPopN(std::back_inserter(keys), 0) != 0 || queue.TryPopN(std::back_inserter(keys), 30) != 30 ||
+        queue.TryPopN(std::back_inserter(keys), 100) != 70 || queue.TryPopN(std::back_inserter(keys), 10) != 0)
+    {
+        std::cerr << "FAILURE: Popped " << keys.size() << " keys in batches, expected 100" << std::endl;
+        return 1;
+    }
+    for (uint64_t i = 0; i < 100; i++)
+    {
+        if (keys[i] != i)
+        {
+            std::cerr << "FAILURE: Read " << keys[i] << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+    if (queue.GetSize() != 0)
+    {
+        std::cerr << "FAILURE: Size " << queue.GetSize() << " after popping everything" << std::endl;
+        return 1;
+    }
+
+    if (!run<CSLPQ::KVQueue<uint64_t, uint64_t>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 8, EpochTraits>>("Epoch"))
+    {
+        return 1;
+    }
+
+    return 0;
+}
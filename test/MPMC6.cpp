@@ -0,0 +1,136 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 40000
+#define THREADS 4
+#define BOUND 16
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    std::atomic<uint64_t> count(0);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            for (uint64_t i = t * COUNT / THREADS; i < (t + 1) * COUNT / THREADS; i++)
+            {
+                queue.Push(keys[i], keys[i] + 1);
+            }
+        });
+        ts.emplace_back([&, t]()
+        {
+            while (count < COUNT)
+            {
+                uint64_t key = 0;
+                uint64_t value = 0;
+                if (queue.TryPopRelaxed(key, value, BOUND))
+                {
+                    if (value != key + 1)
+                    {
+                        key = COUNT;
+                    }
+                    popped[t].push_back(key);
+                    count++;
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < 2 * THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Key " << i << " missing, mismatched or read twice" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    // A bound of one is strict
+    CSLPQ::Queue<uint64_t> queue;
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        queue.Push(999 - i);
+    }
+    for (uint64_t i = 0; i < 500; i++)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPopRelaxed(key, 1) || key != i)
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+            return 1;
+        }
+    }
+
+    // Otherwise pops stay close to the front, measured as the rank of the popped key among the remaining ones
+    std::set<uint64_t> remaining;
+    for (uint64_t i = 500; i < 1000; i++)
+    {
+        remaining.insert(i);
+    }
+    uint64_t total_rank = 0;
+    for (uint64_t i = 0; i < 500; i++)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPopRelaxed(key, BOUND) || remaining.find(key) == remaining.end())
+        {
+            std::cerr << "FAILURE: Read " << key << " which is not in the queue" << std::endl;
+            return 1;
+        }
+        total_rank += std::distance(remaining.begin(), remaining.find(key));
+        remaining.erase(key);
+    }
+    uint64_t key;
+    if (queue.TryPopRelaxed(key, BOUND))
+    {
+        std::cerr << "FAILURE: Read " << key << " from empty queue" << std::endl;
+        return 1;
+    }
+    if (total_rank / 500 >= BOUND)
+    {
+        std::cerr << "FAILURE: Average rank " << total_rank / 500 << " not below " << BOUND << std::endl;
+        return 1;
+    }
+
+    if (!run<CSLPQ::KVQueue<uint64_t, uint64_t>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 8, EpochTraits>>("Epoch"))
+    {
+        return 1;
+    }
+
+    return 0;
+}
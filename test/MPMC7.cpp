@@ -0,0 +1,125 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define ROUNDS 4
+#define BATCH 50
+#define THREADS 4
+
+// Towers of any height up to 32 levels, so the height of the queue keeps growing and shrinking under its users
+struct TallTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::UniformLevel LevelGenerator;
+};
+
+struct TallEpochTraits : TallTraits
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+// Each round fills the queue from empty and drains it again, half the producers push in sorted batches
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    for (uint64_t round = 0; round < ROUNDS; round++)
+    {
+        std::vector<uint64_t> keys;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            keys.emplace_back(i);
+        }
+        std::random_shuffle(keys.begin(), keys.end());
+        std::vector<std::pair<uint64_t, uint64_t>> items;
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            items.emplace_back(keys[i], keys[i]);
+        }
+
+        std::atomic<uint64_t> pushed(0);
+        std::vector<std::vector<uint64_t>> popped(THREADS);
+        std::vector<std::thread> ts;
+        for (uint64_t t = 0; t < THREADS; t++)
+        {
+            ts.emplace_back([&, t]()
+            {
+                uint64_t begin = t * COUNT / THREADS;
+                uint64_t end = (t + 1) * COUNT / THREADS;
+                for (uint64_t i = begin; i < end; i += BATCH)
+                {
+                    uint64_t last = std::min(i + BATCH, end);
+                    if (t % 2)
+                    {
+                        queue.PushBulk(items.begin() + i, items.begin() + last);
+                    }
+                    else
+                    {
+                        for (uint64_t j = i; j < last; j++)
+                        {
+                            queue.Push(keys[j], keys[j]);
+                        }
+                    }
+                    pushed += last - i;
+                    uint64_t key = 0;
+                    uint64_t value = 0;
+                    while (queue.TryPopStrong(key, value))
+                    {
+                        popped[t].push_back(key == value ? key : COUNT);
+                    }
+                }
+                uint64_t key = 0;
+                uint64_t value = 0;
+                while (pushed.load() < COUNT || queue.GetSize())
+                {
+                    if (queue.TryPopStrong(key, value))
+                    {
+                        popped[t].push_back(key == value ? key : COUNT);
+                    }
+                }
+            });
+        }
+        for (uint64_t t = 0; t < THREADS; t++)
+        {
+            ts[t].join();
+        }
+
+        std::vector<uint64_t> all;
+        for (uint64_t t = 0; t < THREADS; t++)
+        {
+            all.insert(all.end(), popped[t].begin(), popped[t].end());
+        }
+        std::sort(all.begin(), all.end());
+        if (all.size() != COUNT)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << all.size() << " keys expected " << COUNT << std::endl;
+            return false;
+        }
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            if (all[i] != i)
+            {
+                std::cerr << "FAILURE-" << name << ": Key " << i << " missing, read twice or with a wrong value"
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    typedef CSLPQ::KVQueue<uint64_t, uint64_t, 31, TallTraits> SharedQueue;
+    typedef CSLPQ::KVQueue<uint64_t, uint64_t, 31, TallEpochTraits> EpochQueue;
+
+    if (!run<SharedQueue>("Shared") || !run<EpochQueue>("Epoch"))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 40000
+#define KEYS 20
+#define THREADS 4
+
+struct TieTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::TieBuckets<16> Ties;
+};
+
+struct TieEpochTraits : TieTraits
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+// Few distinct keys, so concurrent pushes keep landing in buckets that concurrent pops are draining and closing
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::atomic<uint64_t> pushed(0);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                queue.Push(i % KEYS, i);
+                pushed++;
+                if (i % 3 == 0 && queue.TryPopStrong(key, value))
+                {
+                    popped[t].push_back(value % KEYS == key ? value : COUNT);
+                }
+            }
+            while (pushed.load() < COUNT || queue.GetSize())
+            {
+                if (queue.TryPopRelaxed(key, value, 4))
+                {
+                    popped[t].push_back(value % KEYS == key ? value : COUNT);
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.size() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << all.size() << " elements expected " << COUNT << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Element " << i << " missing, read twice or with a wrong key"
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!run<CSLPQ::KVQueue<uint64_t, uint64_t, 8, TieTraits>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 8, TieEpochTraits>>("Epoch"))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#include "CSLPQ/Calendar.hpp"
+
+#define COUNT 100000
+#define THREADS 4
+#define WINDOW 256
+
+// Every thread pushes timestamps drifting forward from a shared clock with jitter, some too far ahead for the ring
+// and some behind the cursor, while all threads pop, so buckets are installed, drained and replaced under the pushes
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::atomic<uint64_t> clock(0);
+    std::atomic<uint64_t> pushed(0);
+    std::vector<std::vector<uint64_t>> popped(THREADS);
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            for (uint64_t i = t; i < COUNT; i += THREADS)
+            {
+                uint64_t now = clock++ / 8 + WINDOW;
+                switch (i % 11)
+                {
+                    case 0:
+                        key = now + 4 * WINDOW;
+                        break;
+                    case 1:
+                        key = now - WINDOW;
+                        break;
+                    default:
+                        key = now + i % 13;
+                }
+                queue.Push(key, i * 4096 + key % 4096);
+                pushed++;
+                if (i % 2 == 0 && queue.TryPop(key, value))
+                {
+                    popped[t].push_back(value % 4096 == key % 4096 ? value / 4096 : COUNT);
+                }
+            }
+            while (pushed.load() < COUNT || queue.GetSize())
+            {
+                if (queue.TryPop(key, value))
+                {
+                    popped[t].push_back(value % 4096 == key % 4096 ? value / 4096 : COUNT);
+                }
+            }
+        });
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+
+    std::vector<uint64_t> all;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        all.insert(all.end(), popped[t].begin(), popped[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.size() != COUNT)
+    {
+        std::cerr << "FAILURE-" << name << ": Read " << all.size() << " elements expected " << COUNT << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        if (all[i] != i)
+        {
+            std::cerr << "FAILURE-" << name << ": Element " << i << " missing, read twice or with a wrong key"
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+int main()
+{
+    typedef CSLPQ::KVCalendarQueue<uint64_t, uint64_t, WINDOW, 16> SharedQueue;
+    typedef CSLPQ::KVCalendarQueue<uint64_t, uint64_t, WINDOW, 16,
+                                   CSLPQ::KVQueue<uint64_t, uint64_t, 31, EpochTraits>> EpochQueue;
+
+    if (!run<SharedQueue>("Shared") || !run<EpochQueue>("Epoch"))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -52,7 +52,7 @@ void remove()
 
 int main()
 {
-    pthread_barrier_init(&barrier, NULL, 10);
+    pthread_barrier_init(&barrier, NULL, 11);
 
     // First, fill the keys and ref
     uint64_t count = 0;
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 40000
+#define THREADS 4
+#define BATCH 1000
+
+struct EpochTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::EpochReclamation Reclamation;
+};
+
+template <typename Q>
+bool run(const char* name)
+{
+    Q queue;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        keys.emplace_back(i);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+
+    // Producers insert interleaving batches, the consumer pops concurrently
+    std::vector<std::thread> ts;
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts.emplace_back([&, t]()
+        {
+            std::vector<std::pair<uint64_t, uint64_t>> batch;
+            for (uint64_t i = t * COUNT / THREADS; i < (t + 1) * COUNT / THREADS; i++)
+            {
+                batch.emplace_back(keys[i], keys[i] * 2);
+                if (batch.size() == BATCH)
+                {
+                    queue.PushBulk(batch.begin(), batch.end());
+                    batch.clear();
+                }
+            }
+            queue.PushBulk(batch.begin(), batch.end());
+        });
+    }
+
+    std::vector<bool> seen(COUNT, false);
+    for (uint64_t i = 0; i < COUNT; i++)
+    {
+        uint64_t key = 0;
+        uint64_t value = 0;
+        queue.Pop(key, value);
+        if (key >= COUNT || seen[key] || value != key * 2)
+        {
+            std::cerr << "FAILURE-" << name << ": Read " << key << ": " << value << " unexpectedly" << std::endl;
+            for (uint64_t t = 0; t < THREADS; t++)
+            {
+                ts[t].join();
+            }
+            return false;
+        }
+        seen[key] = true;
+    }
+    for (uint64_t t = 0; t < THREADS; t++)
+    {
+        ts[t].join();
+    }
+    return true;
+}
+
+int main()
+{
+    // A batch with duplicates spliced into a queue that already holds some of the same keys
+    CSLPQ::Queue<uint64_t> queue;
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> expected;
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        queue.Push(i * 3);
+        expected.push_back(i * 3);
+        keys.push_back(i % 500);
+        keys.push_back(i * 3);
+    }
+    std::random_shuffle(keys.begin(), keys.end());
+    queue.PushBulk(keys.begin(), keys.end());
+    expected.insert(expected.end(), keys.begin(), keys.end());
+    std::sort(expected.begin(), expected.end());
+    for (uint64_t i = 0; i < expected.size(); i++)
+    {
+        uint64_t key = 0;
+        if (!queue.TryPop(key) || key != expected[i])
+        {
+            std::cerr << "FAILURE: Read " << key << " expected " << expected[i] << std::endl;
+            return 1;
+        }
+    }
+    uint64_t key;
+    if (queue.TryPop(key))
+    {
+        std::cerr << "FAILURE: Read " << key << " from empty queue" << std::endl;
+        return 1;
+    }
+
+    if (!run<CSLPQ::KVQueue<uint64_t, uint64_t>>("Shared") ||
+        !run<CSLPQ::KVQueue<uint64_t, uint64_t, 8, EpochTraits>>("Epoch"))
+    {
+        return 1;
+    }
+
+    return 0;
+}
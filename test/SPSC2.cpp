@@ -25,7 +25,7 @@ void remove()
     uint64_t count = 0;
     while (true)
     {
-        uint64_t key;
+        uint64_t key = 0;
         void* value;
         if (queue.TryPop(key, value))
         {
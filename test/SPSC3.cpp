@@ -0,0 +1,152 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+
+#include "CSLPQ/Queue.hpp"
+
+#define COUNT 20000
+#define BOUND 16
+
+struct StripedTraits : CSLPQ::DefaultTraits<uint64_t>
+{
+    typedef CSLPQ::StripedCounter<4> Counter;
+};
+
+int main()
+{
+    // Blocking pops against a producer of increasing keys, the consumer must see every key in order
+    {
+        CSLPQ::Queue<uint64_t> queue;
+        std::atomic<bool> failed(false);
+        std::thread consumer([&]()
+        {
+            for (uint64_t i = 0; i < COUNT; i++)
+            {
+                uint64_t key = 0;
+                queue.Pop(key);
+                if (key != i)
+                {
+                    std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+                    failed = true;
+                    return;
+                }
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            queue.Push(i);
+        }
+        consumer.join();
+        if (failed)
+        {
+            return 1;
+        }
+    }
+
+    // A timed pop on an empty queue gives up after the timeout
+    {
+        CSLPQ::KVQueue<uint64_t, uint64_t> queue;
+        uint64_t key = 0;
+        uint64_t value = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (queue.TryPopFor(key, value, std::chrono::milliseconds(20)))
+        {
+            std::cerr << "FAILURE: Read " << key << " from empty queue" << std::endl;
+            return 1;
+        }
+        if (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(20))
+        {
+            std::cerr << "FAILURE: Timed pop returned before its timeout" << std::endl;
+            return 1;
+        }
+        queue.Push(7, 14);
+        if (!queue.TryPopFor(key, value, std::chrono::seconds(10)) || key != 7 || value != 14)
+        {
+            std::cerr << "FAILURE: Read " << key << ": " << value << " expected 7: 14" << std::endl;
+            return 1;
+        }
+    }
+
+    // A bounded queue parks its producer until the consumer makes room
+    {
+        CSLPQ::KVQueue<uint64_t, uint64_t> queue(BOUND);
+        std::atomic<bool> failed(false);
+        std::thread producer([&]()
+        {
+            for (uint64_t i = 0; i < COUNT; i++)
+            {
+                queue.Push(i, i);
+                if (queue.GetSize() > BOUND)
+                {
+                    std::cerr << "FAILURE: Size " << queue.GetSize() << " above bound" << std::endl;
+                    failed = true;
+                }
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (queue.GetSize() != BOUND)
+        {
+            std::cerr << "FAILURE: Size " << queue.GetSize() << " expected " << BOUND << std::endl;
+            failed = true;
+        }
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            uint64_t key = 0;
+            uint64_t value = 0;
+            queue.Pop(key, value);
+            // Keep popping on failure, the producer would never finish otherwise
+            if ((key != i || value != i) && !failed)
+            {
+                std::cerr << "FAILURE: Read " << key << ": " << value << " expected " << i << std::endl;
+                failed = true;
+            }
+        }
+        producer.join();
+        if (failed)
+        {
+            return 1;
+        }
+    }
+
+    // The same with a striped count, the bound holds on the sum of the stripes
+    {
+        CSLPQ::Queue<uint64_t, 31, StripedTraits> queue(BOUND);
+        std::atomic<bool> failed(false);
+        std::thread producer([&]()
+        {
+            for (uint64_t i = 0; i < COUNT; i++)
+            {
+                queue.Push(i);
+                if (queue.GetSize() > BOUND)
+                {
+                    std::cerr << "FAILURE: Size " << queue.GetSize() << " above bound" << std::endl;
+                    failed = true;
+                }
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (queue.GetSize() != BOUND)
+        {
+            std::cerr << "FAILURE: Size " << queue.GetSize() << " expected " << BOUND << std::endl;
+            failed = true;
+        }
+        for (uint64_t i = 0; i < COUNT; i++)
+        {
+            uint64_t key = 0;
+            queue.Pop(key);
+            if (key != i && !failed)
+            {
+                std::cerr << "FAILURE: Read " << key << " expected " << i << std::endl;
+                failed = true;
+            }
+        }
+        producer.join();
+        if (failed || queue.GetSize())
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}